@@ -0,0 +1,292 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bit_mask.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <stdexcept>
+
+/*
+ * dst bit x &= src bit x + shift, zero beyond the end of the row.
+ */
+static void and_shifted_row(const uint64_t* src, uint64_t* dst, int num_words, int shift)
+{
+  const int word_shift = shift >> 6;
+  const int bit_shift = shift & 63;
+  for (int i = 0; i < num_words; ++i)
+  {
+    const int j = i + word_shift;
+    const uint64_t lo = j < num_words ? src[j] : 0;
+    const uint64_t hi = j + 1 < num_words ? src[j + 1] : 0;
+    dst[i] &= bit_shift == 0 ? lo : (lo >> bit_shift) | (hi << (64 - bit_shift));
+  }
+}
+
+BitMask::BitMask(int rows, int cols, bool value) :
+  m_rows(rows),
+  m_cols(cols),
+  m_words_per_row((cols + 63) / 64),
+  m_words(static_cast<size_t>(rows) * ((cols + 63) / 64), value ? ~uint64_t(0) : 0)
+{
+  if (value && (cols & 63))
+  {
+    const uint64_t last = (uint64_t(1) << (cols & 63)) - 1;
+    for (int y = 0; y < m_rows; ++y)
+    {
+      row(y)[m_words_per_row - 1] = last;
+    }
+  }
+}
+
+BitMask::BitMask(const cv::Mat& mask) :
+  BitMask(mask.rows, mask.cols)
+{
+  if (mask.type() != CV_8UC1)
+  {
+    throw(std::invalid_argument("BitMask: mask must be of type CV_8UC1."));
+  }
+
+  for (int y = 0; y < m_rows; ++y)
+  {
+    const unsigned char* ptr = mask.ptr<unsigned char>(y);
+    uint64_t* ptr_bits = row(y);
+    for (int i = 0; i < m_words_per_row; ++i)
+    {
+      const int x_begin = i * 64;
+      const int x_end = std::min(x_begin + 64, m_cols);
+      uint64_t word = 0;
+      for (int x = x_begin; x < x_end; ++x)
+      {
+        word |= static_cast<uint64_t>(ptr[x] != 0) << (x - x_begin);
+      }
+      ptr_bits[i] = word;
+    }
+  }
+}
+
+cv::Mat BitMask::to_mat(unsigned char value) const
+{
+  return to_mat(cv::Rect(0, 0, m_cols, m_rows), value);
+}
+
+cv::Mat BitMask::to_mat(cv::Rect rect, unsigned char value) const
+{
+  rect &= cv::Rect(0, 0, m_cols, m_rows);
+  cv::Mat mask(rect.size(), CV_8UC1);
+  for (int y = 0; y < rect.height; ++y)
+  {
+    const uint64_t* ptr_bits = row(rect.y + y);
+    unsigned char* ptr = mask.ptr<unsigned char>(y);
+    for (int x = 0; x < rect.width; ++x)
+    {
+      const int xb = rect.x + x;
+      ptr[x] = ((ptr_bits[xb >> 6] >> (xb & 63)) & 1u) ? value : 0;
+    }
+  }
+  return mask;
+}
+
+BitMask& BitMask::operator&=(const BitMask& rhs)
+{
+  if (rhs.m_rows != m_rows || rhs.m_cols != m_cols)
+  {
+    throw(std::invalid_argument("BitMask: masks must have the same size."));
+  }
+
+  const size_t n = m_words.size();
+  uint64_t* dst = m_words.data();
+  const uint64_t* src = rhs.m_words.data();
+  for (size_t i = 0; i < n; ++i)
+  {
+    dst[i] &= src[i];
+  }
+  return *this;
+}
+
+BitMask& BitMask::operator|=(const BitMask& rhs)
+{
+  if (rhs.m_rows != m_rows || rhs.m_cols != m_cols)
+  {
+    throw(std::invalid_argument("BitMask: masks must have the same size."));
+  }
+
+  const size_t n = m_words.size();
+  uint64_t* dst = m_words.data();
+  const uint64_t* src = rhs.m_words.data();
+  for (size_t i = 0; i < n; ++i)
+  {
+    dst[i] |= src[i];
+  }
+  return *this;
+}
+
+int BitMask::count() const
+{
+  size_t n = 0;
+  for (uint64_t word : m_words)
+  {
+    n += std::bitset<64>(word).count();
+  }
+  return static_cast<int>(n);
+}
+
+void BitMask::erode_rows(int width, int covered)
+{
+  if (width <= covered)
+  {
+    return;
+  }
+
+  // Doubling: after each step, bit x holds the AND over [x, x + covered).
+  std::vector<uint64_t> tmp(m_words_per_row);
+  for (int y = 0; y < m_rows; ++y)
+  {
+    uint64_t* ptr = row(y);
+    for (int c = covered; c < width; )
+    {
+      const int step = std::min(c, width - c);
+      std::copy(ptr, ptr + m_words_per_row, tmp.begin());
+      and_shifted_row(tmp.data(), ptr, m_words_per_row, step);
+      c += step;
+    }
+  }
+}
+
+void BitMask::erode_cols(int height)
+{
+  if (height <= 1)
+  {
+    return;
+  }
+
+  // van Herk/Gil-Werman: within blocks of height rows, prefix ANDs from the top
+  // and suffix ANDs from the bottom; row y is suffix[y] & prefix[y + height - 1].
+  const size_t n = m_words.size();
+  const int w = m_words_per_row;
+  std::vector<uint64_t> prefix(n);
+  std::vector<uint64_t> suffix(n);
+  for (int y = 0; y < m_rows; ++y)
+  {
+    uint64_t* p = prefix.data() + static_cast<size_t>(y) * w;
+    const uint64_t* src = row(y);
+    if (y % height == 0)
+    {
+      std::copy(src, src + w, p);
+    }
+    else
+    {
+      const uint64_t* p_prev = p - w;
+      for (int i = 0; i < w; ++i)
+      {
+        p[i] = p_prev[i] & src[i];
+      }
+    }
+  }
+  for (int y = m_rows - 1; y >= 0; --y)
+  {
+    uint64_t* s = suffix.data() + static_cast<size_t>(y) * w;
+    const uint64_t* src = row(y);
+    if (y % height == height - 1 || y == m_rows - 1)
+    {
+      std::copy(src, src + w, s);
+    }
+    else
+    {
+      const uint64_t* s_next = s + w;
+      for (int i = 0; i < w; ++i)
+      {
+        s[i] = s_next[i] & src[i];
+      }
+    }
+  }
+
+  for (int y = 0; y < m_rows; ++y)
+  {
+    uint64_t* dst = row(y);
+    if (y + height - 1 >= m_rows)
+    {
+      std::fill(dst, dst + w, 0);
+      continue;
+    }
+    const uint64_t* s = suffix.data() + static_cast<size_t>(y) * w;
+    const uint64_t* p = prefix.data() + static_cast<size_t>(y + height - 1) * w;
+    for (int i = 0; i < w; ++i)
+    {
+      dst[i] = s[i] & p[i];
+    }
+  }
+}
+
+BitMask BitMask::erode(int width, int height) const
+{
+  BitMask result(*this);
+  result.erode_rows(width);
+  result.erode_cols(height);
+  return result;
+}
+
+BitMask BitMask::erode(const RowRunMask& kernel_runs) const
+{
+  BitMask result(m_rows, m_cols, true);
+  if (empty())
+  {
+    return result;
+  }
+
+  // Runs by ascending length, so each row erosion extends the previous one in a single working buffer.
+  std::vector<RowRunMask::Run> runs = kernel_runs.runs();
+  std::stable_sort(runs.begin(), runs.end(), [](const RowRunMask::Run& lhs, const RowRunMask::Run& rhs)
+  {
+    return lhs.length < rhs.length;
+  });
+
+  BitMask eroded(*this);
+  int covered = 1;
+  for (const RowRunMask::Run& run : runs)
+  {
+    if (run.length > covered)
+    {
+      eroded.erode_rows(run.length, covered);
+      covered = run.length;
+    }
+
+    for (int y = 0; y < m_rows; ++y)
+    {
+      uint64_t* dst = result.row(y);
+      if (y + run.row >= m_rows)
+      {
+        std::fill(dst, dst + m_words_per_row, 0);
+      }
+      else
+      {
+        and_shifted_row(eroded.row(y + run.row), dst, m_words_per_row, run.col);
+      }
+    }
+  }
+
+  return result;
+}
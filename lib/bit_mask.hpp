@@ -0,0 +1,142 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_BIT_MASK_HPP_
+#define TRLIB_BIT_MASK_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "sqdiff_kernels.hpp"
+
+/*
+ * Binary mask with one bit per pixel, packed into 64 bit words per row (bit x
+ * of a row is bit x % 64 of word x / 64). Bits beyond the last column are kept
+ * zero. AND/OR (min/max of binary masks) work on whole words. Erosions are
+ * anchored at the top left corner of the kernel and treat pixels outside of
+ * the mask as unset, like cv::erode with cv::Point(0, 0) and a constant 0
+ * border.
+ */
+class BitMask
+{
+public:
+  BitMask() = default;
+  BitMask(int rows, int cols, bool value = false);
+
+  /*
+   * Sets all pixels of a CV_8UC1 mask that are non-zero.
+   */
+  explicit BitMask(const cv::Mat& mask);
+
+  /*
+   * CV_8UC1 mask with value at set pixels and 0 elsewhere, either of the whole
+   * mask or of rect only.
+   */
+  cv::Mat to_mat(unsigned char value = 255) const;
+  cv::Mat to_mat(cv::Rect rect, unsigned char value = 255) const;
+
+  int rows() const
+  {
+    return m_rows;
+  }
+
+  int cols() const
+  {
+    return m_cols;
+  }
+
+  cv::Size size() const
+  {
+    return cv::Size(m_cols, m_rows);
+  }
+
+  bool empty() const
+  {
+    return m_words.empty();
+  }
+
+  int words_per_row() const
+  {
+    return m_words_per_row;
+  }
+
+  uint64_t* row(int y)
+  {
+    return m_words.data() + static_cast<size_t>(y) * m_words_per_row;
+  }
+
+  const uint64_t* row(int y) const
+  {
+    return m_words.data() + static_cast<size_t>(y) * m_words_per_row;
+  }
+
+  bool get(int x, int y) const
+  {
+    return (row(y)[x >> 6] >> (x & 63)) & 1u;
+  }
+
+  BitMask& operator&=(const BitMask& rhs);
+  BitMask& operator|=(const BitMask& rhs);
+
+  /*
+   * Number of set pixels.
+   */
+  int count() const;
+
+  /*
+   * Erosion with a width x height rectangle: rows with O(log width) word
+   * operations per 64 pixels, columns with the van Herk/Gil-Werman scheme in
+   * three word operations per row, independent of height.
+   */
+  BitMask erode(int width, int height) const;
+
+  /*
+   * Erosion with an arbitrary kernel given by its row runs. Runs are visited by
+   * ascending length and a single row erosion is extended from one length to
+   * the next, each run then adds one shifted AND per row.
+   */
+  BitMask erode(const RowRunMask& kernel_runs) const;
+
+private:
+  // Extends an erosion of the rows by covered pixels to width pixels.
+  void erode_rows(int width, int covered = 1);
+  void erode_cols(int height);
+
+  int m_rows = 0;
+  int m_cols = 0;
+  int m_words_per_row = 0;
+  std::vector<uint64_t> m_words;
+};
+
+inline BitMask operator&(BitMask lhs, const BitMask& rhs)
+{
+  return lhs &= rhs;
+}
+
+inline BitMask operator|(BitMask lhs, const BitMask& rhs)
+{
+  return lhs |= rhs;
+}
+
+#endif /* TRLIB_BIT_MASK_HPP_ */
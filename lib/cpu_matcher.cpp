@@ -0,0 +1,683 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cpu_matcher.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <omp.h>
+
+#include "affine_transformation.hpp"
+#include "rotated_kernel.hpp"
+#include "thread_pool.hpp"
+
+#ifndef TRLIB_MATCHING_NUM_THREADS
+#define TRLIB_MATCHING_NUM_THREADS omp_get_max_threads()
+#define TRLIB_OMP_MATCH_THREADS
+#else
+#if TRLIB_MATCHING_NUM_THREADS == 0
+#undef TRLIB_MATCHING_NUM_THREADS
+#define TRLIB_MATCHING_NUM_THREADS omp_get_max_threads()
+#define TRLIB_OMP_MATCH_THREADS num_threads(TRLIB_MATCHING_NUM_THREADS)
+#else
+#define TRLIB_OMP_DISABLE_DYNAMIC
+#define TRLIB_OMP_MATCH_THREADS num_threads(TRLIB_MATCHING_NUM_THREADS)
+#endif
+#endif
+
+CPUMatcher::CPUMatcher(bool check_candidate_masks) :
+  m_check_candidate_masks(check_candidate_masks),
+  m_validity_cache(0.0)
+{
+}
+
+void CPUMatcher::set_options(const MatchingOptions& options, cv::Size max_patch_size, cv::Size subpatch_size)
+{
+  m_options = options;
+  m_options.feature_memory_budget_mb = std::max(m_options.feature_memory_budget_mb, 0.0);
+  m_options.pyramid_min_kernel_size = m_options.pyramid_min_kernel_size > 0 ? m_options.pyramid_min_kernel_size : std::min(max_patch_size.width, max_patch_size.height);
+  m_options.num_match_candidates = std::max(m_options.num_match_candidates, 1);
+  m_options.match_candidate_nms_radius = m_options.match_candidate_nms_radius >= 0 ? m_options.match_candidate_nms_radius : subpatch_size.width;
+  m_options.region_lookahead = std::max(m_options.region_lookahead, 0);
+  m_options.local_refinement_radius = std::max(m_options.local_refinement_radius, 0);
+  m_options.local_refinement_rotations = std::max(m_options.local_refinement_rotations, 0);
+  m_options.match_tile_rows = std::max(m_options.match_tile_rows, 0);
+  if (m_options.num_match_candidates > 1 && (m_options.early_termination || m_options.lower_bound_pruning))
+  {
+    // Skipped positions are left at FLT_MAX, so the candidates after the best one would be wrong.
+    std::cerr << "WARNING: early_termination and lower_bound_pruning are ignored with num_match_candidates > 1." << std::endl;
+    m_options.early_termination = false;
+    m_options.lower_bound_pruning = false;
+  }
+  if (m_options.region_lookahead > 0 && !m_options.speculative_matching)
+  {
+    // Searched one after another, the regions ahead would only be searched earlier, and again when invalidated.
+    std::cerr << "WARNING: region_lookahead is ignored without speculative_matching." << std::endl;
+    m_options.region_lookahead = 0;
+  }
+
+  m_pyramid_matcher = PyramidMatcher(m_options.pyramid_levels, m_options.pyramid_candidates, m_options.pyramid_refine_radius, m_options.pyramid_exact);
+  m_validity_cache = ValidityCache(m_options.validity_cache_budget_mb < 0.0 ? -1.0 : m_options.validity_cache_budget_mb * 1024.0 * 1024.0);
+  m_scheduler.clear();
+}
+
+void CPUMatcher::prepare(std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, bool keep_u16) const
+{
+  build_feature_store(targets, textures, keep_u16);
+
+  if (m_options.lower_bound_pruning)
+  {
+    std::cout << "Compute texture integral images..." << std::endl;
+    for (std::vector<Texture>& textures_rot : textures)
+    {
+      for (Texture& t : textures_rot)
+      {
+        if (t.response.num_channels() > 0)
+        {
+          t.compute_response_integral();
+        }
+      }
+    }
+    std::cout << "done" << std::endl;
+  }
+
+  if (m_pyramid_matcher.enabled() && !m_options.rotate_kernel)
+  {
+    std::cout << "Compute texture pyramids..." << std::endl;
+    for (std::vector<Texture>& textures_rot : textures)
+    {
+      for (Texture& t : textures_rot)
+      {
+        t.compute_response_pyramid(m_pyramid_matcher.num_levels());
+      }
+    }
+    std::cout << "done" << std::endl;
+  }
+
+  if (m_options.fft_matching && !m_options.rotate_kernel)
+  {
+    std::cout << "Compute texture spectra..." << std::endl;
+    for (std::vector<Texture>& textures_rot : textures)
+    {
+      /*
+       * All rotations of a texture share one DFT size, so kernel spectra can be
+       * computed once per texture and reused for every rotation.
+       */
+      cv::Size size_max;
+      for (const Texture& t : textures_rot)
+      {
+        size_max.width = std::max(size_max.width, t.response.cols());
+        size_max.height = std::max(size_max.height, t.response.rows());
+      }
+
+      const cv::Size dft_size = FeatureSpectrum::optimal_dft_size(size_max);
+      for (Texture& t : textures_rot)
+      {
+        t.compute_response_spectrum(dft_size);
+      }
+    }
+    std::cout << "done" << std::endl;
+  }
+}
+
+void CPUMatcher::build_feature_store(std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, bool keep_u16) const
+{
+  if (m_options.feature_store_budget_mb == 0.0)
+  {
+    return;
+  }
+
+  // Targets first, since every match reads them, then textures until the budget is used up.
+  std::vector<FeatureVector*> features;
+  for (Texture& target : targets)
+  {
+    features.push_back(&target.response);
+  }
+  for (std::vector<Texture>& textures_rot : textures)
+  {
+    for (Texture& t : textures_rot)
+    {
+      if (t.response.num_channels() > 0)
+      {
+        features.push_back(&t.response);
+      }
+    }
+  }
+
+  // uint16 matching and rotated kernels read the CV_16U channels, which would be converted back from the float store on every access.
+  const bool drop_u16 = m_options.feature_store_drop_u16 && !keep_u16 && m_options.matching_precision == MatchingPrecision::Float32 && !m_options.rotate_kernel;
+  if (m_options.feature_store_drop_u16 && !drop_u16)
+  {
+    std::cerr << "WARNING: feature_store_drop_u16 is ignored with OpenCL, uint16 matching precision or rotate_kernel." << std::endl;
+  }
+
+  const bool unlimited = m_options.feature_store_budget_mb < 0.0;
+  const double budget_bytes = m_options.feature_store_budget_mb * 1024.0 * 1024.0;
+  double used_bytes = 0.0;
+  int num_stored = 0;
+
+  std::cout << "Compute float feature store..." << std::endl;
+  for (FeatureVector* f : features)
+  {
+    const double bytes = static_cast<double>(f->float_store_bytes());
+    if (!unlimited && used_bytes + bytes > budget_bytes)
+    {
+      break;
+    }
+
+    f->compute_float_store();
+    if (drop_u16)
+    {
+      f->release_u16();
+    }
+    used_bytes += bytes;
+    ++num_stored;
+  }
+  std::cout << "done (" << num_stored << "/" << features.size() << " feature vectors, " << used_bytes / (1024.0 * 1024.0) << " MB)" << std::endl;
+}
+
+void CPUMatcher::clear_caches()
+{
+  m_scheduler.clear();
+  m_validity_cache.clear();
+}
+
+void CPUMatcher::clear()
+{
+  clear_caches();
+  m_placement_index.clear();
+}
+
+void CPUMatcher::patch_placed(const Patch& patch, cv::Size size, const std::vector<cv::Rect>& boxes)
+{
+  m_scheduler.consume(patch);
+  m_placement_index.insert(patch, size);
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    m_validity_cache.invalidate(patch.source_index, static_cast<int>(i), boxes[i]);
+  }
+}
+
+int CPUMatcher::patch_released(const Patch& patch, cv::Size size, const std::vector<cv::Rect>& boxes)
+{
+  const int num_released = m_scheduler.release(patch);
+  m_placement_index.erase(patch, size);
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    m_validity_cache.invalidate(patch.source_index, static_cast<int>(i), boxes[i]);
+  }
+  return num_released;
+}
+
+bool CPUMatcher::matches_reusable() const
+{
+  /*
+   * A match searched against an earlier mask state is placed only while its
+   * source area is still available. Placements only take material away, so it
+   * is then also the first best match of the later state. This does not hold
+   * for the pyramid matcher, whose candidates depend on the whole mask.
+   */
+  return !m_pyramid_matcher.enabled();
+}
+
+bool CPUMatcher::candidate_available(const MatchCandidate& candidate, const PatchRegion& region, const std::vector<std::vector<Texture>>& textures) const
+{
+  /*
+   * Candidates were valid when they were searched and only placements take
+   * material away since, so the mask only has to be checked when a placed
+   * source area is close. Rotated kernel matches are clamped into the rotated
+   * texture and always checked.
+   */
+  const Texture& texture = textures[candidate.texture_index][candidate.texture_rot];
+  if (!m_check_candidate_masks && !m_options.rotate_kernel && !m_placement_index.intersects(candidate.texture_index, texture.transformation_matrix, cv::Rect(candidate.texture_pos, region.mask().size())))
+  {
+    return true;
+  }
+  return match_candidate_available(texture.mask(), region.mask(), candidate.texture_pos);
+}
+
+bool CPUMatcher::find_stored_match(const PatchRegion& region, const std::vector<std::vector<Texture>>& textures, MatchCandidate& match, MatchingStatistics& stats)
+{
+  const std::vector<MatchCandidate>* scheduled = m_scheduler.find(region);
+  if (!scheduled)
+  {
+    return false;
+  }
+
+  const std::vector<MatchCandidate> candidates = *scheduled;
+  m_scheduler.erase(region);
+  for (size_t i = 0; i < candidates.size(); ++i)
+  {
+    if (candidate_available(candidates[i], region, textures))
+    {
+      // Only the first candidate is exact, later ones replace a rematch.
+      ++stats.num_scheduled_hits;
+      stats.num_cached_candidates += i > 0;
+      match = candidates[i];
+      return true;
+    }
+  }
+
+  ++stats.num_scheduled_invalidations;
+  return false;
+}
+
+MatchCandidate CPUMatcher::search(const PatchRegion& region, cv::Mat mask, std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, MatchingStatistics& stats, bool speculative, std::vector<MatchCandidate>* candidates)
+{
+  if (textures.empty())
+  {
+    throw(std::invalid_argument("CPUMatcher::search called but no textures supplied."));
+  }
+
+  struct MatchPatchResult
+  {
+    MatchPatchResult(int texture_index, int texture_rot) :
+      texture_index(texture_index),
+      texture_rot(texture_rot),
+      cost(std::numeric_limits<double>::max()),
+      texture_pos(-1, -1)
+    {}
+
+    int texture_index;
+    int texture_rot;
+    double cost;
+    cv::Point texture_pos;
+    MatchingStatistics stats;
+    std::vector<MatchCandidate> candidates;
+    cv::Mat valid;
+    cv::Mat match;
+  };
+
+  const bool is_rectangular = (mask.empty() || cv::countNonZero(mask) == mask.rows*mask.cols);
+
+  Texture kernel = targets[region.target_index()](region.bounding_box());
+
+  std::vector<FeatureSpectrum> kernel_spectra(textures.size());
+  if (is_rectangular && m_options.fft_matching)
+  {
+    for (size_t i = 0; i < textures.size(); ++i)
+    {
+      if (!textures[i].front().response_spectrum.empty())
+      {
+        kernel_spectra[i] = FeatureSpectrum(kernel.response, textures[i].front().response_spectrum.dft_size());
+      }
+    }
+  }
+
+  // Non-rectangular regions (and all regions in uint16 or bounded mode) are matched directly on the active pixels of the mask.
+  const MatchingPrecision precision = m_options.matching_precision;
+  const bool match_bounded = m_options.early_termination || m_options.lower_bound_pruning;
+  const bool match_direct = !is_rectangular || precision == MatchingPrecision::UInt16 || match_bounded;
+  RowRunMask kernel_runs;
+  if (match_direct)
+  {
+    kernel_runs = RowRunMask(region.mask());
+    if (precision == MatchingPrecision::Float32 && !kernel.response.has_float_store())
+    {
+      kernel.response.compute_float_store();
+    }
+  }
+
+  SharedBound bound;
+  std::vector<int> channel_order;
+  if (match_bounded)
+  {
+    channel_order = channel_order_by_energy(kernel.response, kernel_runs);
+  }
+
+  const bool use_pyramid = m_pyramid_matcher.enabled() && std::min(kernel.response.cols(), kernel.response.rows()) >= m_options.pyramid_min_kernel_size;
+
+  std::vector<MatchPatchResult> results;
+  for (size_t i = 0; i < textures.size(); ++i)
+  {
+    for (size_t j = 0; j < textures[i].size(); ++j)
+    {
+      results.emplace_back(static_cast<int>(i), static_cast<int>(j));
+    }
+  }
+
+  // Validity maps are looked up serially; each one is then only updated by the thread matching its texture rotation.
+  std::vector<ValidityMap*> validity_maps(results.size(), nullptr);
+  if (!m_options.rotate_kernel && !is_rectangular && !speculative)
+  {
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      validity_maps[i] = m_validity_cache.find(results[i].texture_index, results[i].texture_rot, textures[results[i].texture_index][results[i].texture_rot], region.mask());
+    }
+  }
+
+  // OpenCV stays single-threaded while the OpenMP loops below are running.
+  ThreadPool::ParallelScope parallel_scope;
+#ifdef TRLIB_OMP_DISABLE_DYNAMIC
+  omp_set_dynamic(false);
+#endif
+  #pragma omp parallel for TRLIB_OMP_MATCH_THREADS
+  for (int i = 0; i < static_cast<int>(results.size()); ++i)
+  {
+    if (m_options.rotate_kernel)
+    {
+      results[i].candidates = match_rotated_kernel(kernel.response, region.mask(), textures[results[i].texture_index], results[i].texture_index, results[i].texture_rot, &results[i].stats);
+      if (!results[i].candidates.empty())
+      {
+        results[i].cost = results[i].candidates.front().cost;
+        results[i].texture_pos = results[i].candidates.front().texture_pos;
+      }
+      continue;
+    }
+
+    Texture& texture = textures[results[i].texture_index][results[i].texture_rot];
+    cv::Mat texture_mask;
+    int num_valid;
+    if (is_rectangular)
+    {
+      // Rectangles only need the used-pixel integral of the texture, no erosion.
+      if (texture.mask_used_integral.empty())
+      {
+        texture.compute_mask_integral();
+      }
+      texture_mask = texture.valid_rect_positions(kernel.response.size(), &num_valid);
+    }
+    else if (validity_maps[i])
+    {
+      texture_mask = validity_maps[i]->update(texture, region.mask(), &results[i].stats);
+      num_valid = validity_maps[i]->num_valid();
+    }
+    else
+    {
+      texture_mask = valid_positions(texture.mask(), region.mask(), kernel.response.size());
+      num_valid = cv::countNonZero(texture_mask);
+    }
+
+    if (num_valid > 0)
+    {
+      if (use_pyramid && !texture.response_pyramid.empty())
+      {
+        const PyramidMatcher::Result result = m_pyramid_matcher.match(texture.response_pyramid, kernel.response, region.mask(), texture_mask, &results[i].stats);
+        results[i].cost = result.cost;
+        results[i].texture_pos = result.pos;
+        results[i].candidates.push_back(MatchCandidate{results[i].texture_index, results[i].texture_rot, result.cost, result.pos});
+      }
+      else if (match_direct)
+      {
+        // Direct matches are computed in row tiles below.
+        results[i].valid = texture_mask;
+      }
+      else
+      {
+        cv::Mat match;
+        if (!kernel_spectra[results[i].texture_index].empty())
+        {
+          match = texture.template_match(kernel_spectra[results[i].texture_index]);
+        }
+        else
+        {
+          match = texture.template_match(kernel);
+        }
+        results[i].candidates = select_match_candidates(match, texture_mask, m_options.num_match_candidates, m_options.match_candidate_nms_radius, results[i].texture_index, results[i].texture_rot);
+        if (!results[i].candidates.empty())
+        {
+          results[i].cost = results[i].candidates.front().cost;
+          results[i].texture_pos = results[i].candidates.front().texture_pos;
+        }
+      }
+    }
+  }
+
+  // Direct matches are split into row tiles that are balanced over the threads. Each tile writes its rows of the cost map.
+  struct MatchTile
+  {
+    int result;
+    cv::Range rows;
+  };
+
+  const int tile_rows = m_options.match_tile_rows > 0 ? m_options.match_tile_rows : std::numeric_limits<int>::max();
+  std::vector<MatchTile> tiles;
+  for (int i = 0; i < static_cast<int>(results.size()); ++i)
+  {
+    if (!results[i].valid.empty())
+    {
+      results[i].match = cv::Mat(results[i].valid.size(), CV_32FC1);
+      for (int y = 0; y < results[i].valid.rows; y += std::min(tile_rows, results[i].valid.rows - y))
+      {
+        tiles.push_back(MatchTile{i, cv::Range(y, y + std::min(tile_rows, results[i].valid.rows - y))});
+      }
+    }
+  }
+
+  std::vector<MatchingStatistics> tile_stats(tiles.size());
+  #pragma omp parallel for schedule(dynamic) TRLIB_OMP_MATCH_THREADS
+  for (int t = 0; t < static_cast<int>(tiles.size()); ++t)
+  {
+    MatchPatchResult& result = results[tiles[t].result];
+    const Texture texture = textures[result.texture_index][result.texture_rot].match_rows(tiles[t].rows, kernel.response.size());
+    const cv::Mat valid = result.valid.rowRange(tiles[t].rows);
+    cv::Mat match;
+    if (match_bounded)
+    {
+      match = texture.template_match(kernel, kernel_runs, valid, precision, channel_order, bound, m_options.early_termination, m_options.lower_bound_pruning, &tile_stats[t]);
+    }
+    else
+    {
+      match = texture.template_match(kernel, kernel_runs, valid, precision);
+    }
+    match.copyTo(result.match.rowRange(tiles[t].rows));
+  }
+
+  // The cost maps are reduced per texture rotation in row order, so the result does not depend on how tiles were scheduled.
+  #pragma omp parallel for TRLIB_OMP_MATCH_THREADS
+  for (int i = 0; i < static_cast<int>(results.size()); ++i)
+  {
+    if (!results[i].match.empty())
+    {
+      results[i].candidates = select_match_candidates(results[i].match, results[i].valid, m_options.num_match_candidates, m_options.match_candidate_nms_radius, results[i].texture_index, results[i].texture_rot);
+      if (!results[i].candidates.empty())
+      {
+        results[i].cost = results[i].candidates.front().cost;
+        results[i].texture_pos = results[i].candidates.front().texture_pos;
+      }
+    }
+  }
+#ifdef TRLIB_OMP_DISABLE_DYNAMIC
+  omp_set_dynamic(true);
+#endif
+
+  for (const MatchingStatistics& tile_stat : tile_stats)
+  {
+    stats += tile_stat;
+  }
+
+  if (candidates)
+  {
+    candidates->clear();
+  }
+  for (const MatchPatchResult& result : results)
+  {
+    stats += result.stats;
+    if (candidates)
+    {
+      candidates->insert(candidates->end(), result.candidates.begin(), result.candidates.end());
+    }
+  }
+
+  if (candidates)
+  {
+    merge_match_candidates(*candidates, m_options.num_match_candidates, m_options.match_candidate_nms_radius);
+  }
+
+  const MatchPatchResult& result_min = *std::min_element(results.begin(), results.end(), [](const MatchPatchResult& lhs, const MatchPatchResult& rhs){return lhs.cost < rhs.cost; });
+
+  if (result_min.cost == std::numeric_limits<double>::max() && !speculative)
+  {
+    std::cout << "Finished. No more texture samples available." << std::endl;
+  }
+
+  return MatchCandidate{result_min.texture_index, result_min.texture_rot, result_min.cost, result_min.texture_pos};
+}
+
+std::vector<MatchCandidate> CPUMatcher::search_speculative(const std::vector<const PatchRegion*>& regions, std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, MatchingStatistics& stats, std::vector<std::vector<MatchCandidate>>* candidates)
+{
+  std::vector<MatchCandidate> matches(regions.size());
+  if (candidates)
+  {
+    candidates->resize(regions.size());
+  }
+
+  // The used-pixel integrals are computed lazily during the search, so they have to exist before searching concurrently.
+  for (std::vector<Texture>& rotations : textures)
+  {
+    for (Texture& texture : rotations)
+    {
+      if (texture.mask_used_integral.empty())
+      {
+        texture.compute_mask_integral();
+      }
+    }
+  }
+
+  std::vector<MatchingStatistics> region_stats(regions.size());
+  ThreadPool::ParallelScope parallel_scope;
+  #pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < static_cast<int>(regions.size()); ++i)
+  {
+    matches[i] = search(*regions[i], regions[i]->mask(), targets, textures, region_stats[i], true, candidates ? &(*candidates)[i] : nullptr);
+  }
+
+  for (const MatchingStatistics& s : region_stats)
+  {
+    stats += s;
+  }
+
+  return matches;
+}
+
+MatchCandidate CPUMatcher::search_local(const PatchRegion& region, const Patch& parent, std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures) const
+{
+  MatchCandidate best{parent.source_index, parent.source_rot, std::numeric_limits<double>::max(), cv::Point(-1, -1)};
+
+  Texture kernel = targets[region.target_index()](region.bounding_box());
+  const cv::Size kernel_size = kernel.response.size();
+  const RowRunMask kernel_runs(region.mask());
+  if (m_options.matching_precision == MatchingPrecision::Float32 && !kernel.response.has_float_store())
+  {
+    kernel.response.compute_float_store();
+  }
+
+  // Center of the region in the parent's source area, in unrotated texture coordinates.
+  const Texture& texture_parent = textures[parent.source_index][parent.source_rot];
+  const cv::Point offset = region.bounding_box().tl() - parent.anchor_target();
+  const cv::Point2d center(parent.anchor_source.x + offset.x + 0.5 * kernel_size.width, parent.anchor_source.y + offset.y + 0.5 * kernel_size.height);
+  const cv::Point2d center_unrotated = AffineTransformation::transform(texture_parent.transformation_matrix_inv, center);
+
+  const int radius = m_options.local_refinement_radius;
+  const int num_rotations = static_cast<int>(textures[parent.source_index].size());
+  const int num_neighbors = std::min(m_options.local_refinement_rotations, (num_rotations - 1) / 2);
+  for (int k = -num_neighbors; k <= num_neighbors; ++k)
+  {
+    const int texture_rot = ((parent.source_rot + k) % num_rotations + num_rotations) % num_rotations;
+    Texture& texture = textures[parent.source_index][texture_rot];
+    const cv::Point2d center_rotated = AffineTransformation::transform(texture.transformation_matrix, center_unrotated);
+    const cv::Point anchor(cvRound(center_rotated.x - 0.5 * kernel_size.width), cvRound(center_rotated.y - 0.5 * kernel_size.height));
+
+    // Anchor positions within the radius, clipped to the texture.
+    const cv::Rect positions = cv::Rect(anchor.x - radius, anchor.y - radius, 2 * radius + 1, 2 * radius + 1) &
+      cv::Rect(0, 0, texture.response.cols() - kernel_size.width + 1, texture.response.rows() - kernel_size.height + 1);
+    if (positions.empty())
+    {
+      continue;
+    }
+
+    Texture texture_window = texture(cv::Rect(positions.tl(), positions.size() + kernel_size - cv::Size(1, 1)));
+    const cv::Mat valid = valid_positions(texture_window.mask(), region.mask(), kernel_size);
+    if (cv::countNonZero(valid) == 0)
+    {
+      continue;
+    }
+
+    const cv::Mat match = texture_window.template_match(kernel, kernel_runs, valid, m_options.matching_precision);
+    const std::vector<MatchCandidate> candidates = select_match_candidates(match, valid, 1, 0, parent.source_index, texture_rot);
+    if (!candidates.empty() && candidates.front().cost < best.cost)
+    {
+      best = candidates.front();
+      best.texture_pos += positions.tl();
+    }
+  }
+
+  return best;
+}
+
+FeatureVector CPUMatcher::rotated_response_window(const std::vector<Texture>& rotations, int texture_rot, cv::Rect window) const
+{
+  return ::rotated_response_window(rotations.front().response, rotations[texture_rot].transformation_matrix, window, m_num_frequencies, m_num_directions);
+}
+
+int CPUMatcher::num_threads()
+{
+  return TRLIB_MATCHING_NUM_THREADS;
+}
+
+std::vector<MatchCandidate> CPUMatcher::match_rotated_kernel(const FeatureVector& kernel, const cv::Mat& kernel_mask, const std::vector<Texture>& rotations, int texture_index, int texture_rot, MatchingStatistics* stats) const
+{
+  const Texture& texture = rotations.front();
+  const Texture& texture_rotated = rotations[texture_rot];
+  const MatchingPrecision precision = m_options.matching_precision;
+  const RotatedKernel rotated_kernel(kernel, kernel_mask, texture_rotated.transformation_matrix, precision, m_num_frequencies, m_num_directions);
+
+  const cv::Size kernel_size = rotated_kernel.response().size();
+  if (kernel_size.width > texture.response.cols() || kernel_size.height > texture.response.rows())
+  {
+    return std::vector<MatchCandidate>();
+  }
+
+  cv::Mat texture_mask = valid_positions(texture.mask(), rotated_kernel.mask(), kernel_size);
+  if (cv::countNonZero(texture_mask) == 0)
+  {
+    return std::vector<MatchCandidate>();
+  }
+
+  cv::Mat match;
+  if (m_options.early_termination || m_options.lower_bound_pruning)
+  {
+    // Costs of different rotations are only comparable after scaling, so the bound is not shared between them.
+    SharedBound bound;
+    match = texture.template_match(rotated_kernel.response(), rotated_kernel.runs(), texture_mask, precision, channel_order_by_energy(rotated_kernel.response(), rotated_kernel.runs()), bound, m_options.early_termination, m_options.lower_bound_pruning, stats);
+  }
+  else
+  {
+    match = texture.template_match(rotated_kernel.response(), rotated_kernel.runs(), texture_mask, precision);
+  }
+
+  std::vector<MatchCandidate> candidates = select_match_candidates(match, texture_mask, m_options.num_match_candidates, m_options.match_candidate_nms_radius, texture_index, texture_rot);
+  for (MatchCandidate& candidate : candidates)
+  {
+    candidate.cost *= rotated_kernel.cost_scale();
+    candidate.texture_pos = rotated_kernel.rotated_anchor(candidate.texture_pos, texture_rotated.transformation_matrix, texture_rotated.mask_done.size());
+  }
+  return candidates;
+}
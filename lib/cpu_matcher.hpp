@@ -0,0 +1,179 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_CPU_MATCHER_HPP_
+#define TRLIB_CPU_MATCHER_HPP_
+
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "match_candidates.hpp"
+#include "matching_options.hpp"
+#include "patch.hpp"
+#include "patch_region.hpp"
+#include "placement_index.hpp"
+#include "pyramid_matcher.hpp"
+#include "region_scheduler.hpp"
+#include "sqdiff_kernels.hpp"
+#include "texture.hpp"
+#include "validity_cache.hpp"
+
+/*
+ * CPU search of TreeMatch and TreeMatchGPU. Holds the matching options and the
+ * state kept between searches (scheduled match candidates, validity maps and
+ * placed source areas). Targets and textures stay with the caller and
+ * are passed to every search.
+ */
+class CPUMatcher
+{
+public:
+  /*
+   * With check_candidate_masks, stored matches are always checked on the
+   * texture mask, for positions that are not exact windows of the rotated
+   * texture (OpenCL matches are transformed from the unrotated frame).
+   */
+  explicit CPUMatcher(bool check_candidate_masks = false);
+
+  /*
+   * Clamps the options to their valid ranges and resolves the defaults that
+   * depend on the patch sizes. Early termination and lower bound pruning are
+   * turned off with more than one match candidate, since the positions they
+   * skip would be missing from the candidates, and region_lookahead without
+   * speculative_matching. Clears all stored matches and validity maps.
+   */
+  void set_options(const MatchingOptions& options, cv::Size max_patch_size, cv::Size subpatch_size);
+
+  const MatchingOptions& options() const
+  {
+    return m_options;
+  }
+
+  const PlacementIndex& placement_index() const
+  {
+    return m_placement_index;
+  }
+
+  /*
+   * Gabor orientation channels of the features, num_frequencies blocks of
+   * num_directions channels at the end of the stack (no Gabor features with
+   * num_frequencies = 0). Rotated kernels shift them by the rotation angle.
+   */
+  void set_orientations(int num_frequencies, int num_directions)
+  {
+    m_num_frequencies = num_frequencies;
+    m_num_directions = num_directions;
+  }
+
+  /*
+   * Features of texture rotation texture_rot inside window for rotated
+   * kernels, resampled from the unrotated feature stack.
+   */
+  FeatureVector rotated_response_window(const std::vector<Texture>& rotations, int texture_rot, cv::Rect window) const;
+
+  /*
+   * Float store, integral images, pyramids and spectra of the features, as
+   * needed by the options. With keep_u16, the CV_16U channels are kept for
+   * other matchers.
+   */
+  void prepare(std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, bool keep_u16 = false) const;
+
+  // Drops stored matches and validity maps, e.g. after the features changed.
+  void clear_caches();
+
+  // Additionally forgets all placed source areas.
+  void clear();
+
+  /*
+   * Bookkeeping of a placed or released source area. boxes are the changed
+   * rectangles per texture rotation, as returned by Texture::update_mask_done.
+   * patch_released returns the number of scheduled matches dropped.
+   */
+  void patch_placed(const Patch& patch, cv::Size size, const std::vector<cv::Rect>& boxes);
+  int patch_released(const Patch& patch, cv::Size size, const std::vector<cv::Rect>& boxes);
+
+  /*
+   * Whether a match searched against an earlier mask state may be placed later,
+   * as long as its source area is still available.
+   */
+  bool matches_reusable() const;
+
+  bool candidate_available(const MatchCandidate& candidate, const PatchRegion& region, const std::vector<std::vector<Texture>>& textures) const;
+
+  /*
+   * Match candidates searched ahead of their region's turn, best first.
+   */
+  bool scheduled(const PatchRegion& region) const
+  {
+    return m_scheduler.find(region) != nullptr;
+  }
+
+  void schedule(const PatchRegion& region, std::vector<MatchCandidate> candidates)
+  {
+    m_scheduler.store(region, std::move(candidates));
+  }
+
+  /*
+   * Takes the first scheduled candidate of the region that is still available.
+   * Returns false if the region has to be searched.
+   */
+  bool find_stored_match(const PatchRegion& region, const std::vector<std::vector<Texture>>& textures, MatchCandidate& match, MatchingStatistics& stats);
+
+  /*
+   * Best match of the region over all textures and rotations. With candidates,
+   * the num_match_candidates best matches are returned there, best first.
+   * Speculative searches may run concurrently with each other: they only read
+   * the shared state, so they do not use the validity maps.
+   */
+  MatchCandidate search(const PatchRegion& region, cv::Mat mask, std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, MatchingStatistics& stats, bool speculative = false, std::vector<MatchCandidate>* candidates = nullptr);
+
+  /*
+   * Searches the regions concurrently against the current mask state. With
+   * candidates, the match candidates of every region are returned there.
+   */
+  std::vector<MatchCandidate> search_speculative(const std::vector<const PatchRegion*>& regions, std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, MatchingStatistics& stats, std::vector<std::vector<MatchCandidate>>* candidates = nullptr);
+
+  /*
+   * Best match of a finer region of adaptive matching around its position in
+   * the parent's source area, see MatchingOptions::local_refinement_radius.
+   */
+  MatchCandidate search_local(const PatchRegion& region, const Patch& parent, std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures) const;
+
+  // Threads of the OpenMP loops in search (TRLIB_MATCHING_NUM_THREADS).
+  static int num_threads();
+
+private:
+  std::vector<MatchCandidate> match_rotated_kernel(const FeatureVector& kernel, const cv::Mat& kernel_mask, const std::vector<Texture>& rotations, int texture_index, int texture_rot, MatchingStatistics* stats) const;
+  void build_feature_store(std::vector<Texture>& targets, std::vector<std::vector<Texture>>& textures, bool keep_u16) const;
+
+  bool m_check_candidate_masks;
+  MatchingOptions m_options;
+  int m_num_frequencies = 0;
+  int m_num_directions = 0;
+  PyramidMatcher m_pyramid_matcher;
+  ValidityCache m_validity_cache;
+  RegionScheduler m_scheduler;
+  PlacementIndex m_placement_index;
+};
+
+#endif /* TRLIB_CPU_MATCHER_HPP_ */
@@ -0,0 +1,234 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "feature_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <boost/format.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace fs = boost::filesystem;
+namespace bip = boost::interprocess;
+
+static const char feature_cache_magic[8] = {'T', 'R', 'F', 'E', 'A', 'T', '0', '1'};
+
+struct FeatureCacheHeader
+{
+  char magic[8];
+  uint64_t key;
+  int32_t rows;
+  int32_t cols;
+  int32_t num_channels;
+  int32_t reserved;
+  double transformation_matrix[6];
+};
+
+// FNV-1a, continued from hash.
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t bytes)
+{
+  const unsigned char* ptr = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < bytes; ++i)
+  {
+    hash = (hash ^ ptr[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+template <typename T>
+static uint64_t fnv1a(uint64_t hash, const T& value)
+{
+  return fnv1a(hash, &value, sizeof(T));
+}
+
+static uint64_t fnv1a(uint64_t hash, const cv::Mat& mat)
+{
+  hash = fnv1a(hash, mat.rows);
+  hash = fnv1a(hash, mat.cols);
+  hash = fnv1a(hash, mat.type());
+  const size_t row_bytes = mat.cols * mat.elemSize();
+  for (int y = 0; y < mat.rows; ++y)
+  {
+    hash = fnv1a(hash, mat.ptr(y), row_bytes);
+  }
+  return hash;
+}
+
+FeatureCache::FeatureCache(const fs::path& directory) :
+  m_directory(directory)
+{
+  if (!m_directory.empty() && !fs::exists(m_directory))
+  {
+    fs::create_directories(m_directory);
+  }
+}
+
+uint64_t FeatureCache::source_key(const FeatureEvaluator& evaluator, const Texture& source)
+{
+  uint64_t hash = 14695981039346656037ull;
+  hash = fnv1a(hash, source.texture);
+  hash = fnv1a(hash, source.mask_done);
+  hash = fnv1a(hash, source.mask_rotation);
+  hash = fnv1a(hash, source.scale);
+  hash = fnv1a(hash, source.dpi);
+
+  hash = fnv1a(hash, evaluator.weight_intensity());
+  hash = fnv1a(hash, evaluator.weight_sobel());
+  hash = fnv1a(hash, evaluator.weight_gabor());
+
+  // The filter parameters follow from filter_resolution, frequency_octaves and num_filter_directions.
+  const mat<GaborFilter>& filters = evaluator.filter_bank().filters();
+  hash = fnv1a(hash, filters.height());
+  hash = fnv1a(hash, filters.width());
+  for (int i = 0; i < filters.size(); ++i)
+  {
+    hash = fnv1a(hash, filters[i].frequency);
+    hash = fnv1a(hash, filters[i].theta);
+    hash = fnv1a(hash, filters[i].sigma_x);
+    hash = fnv1a(hash, filters[i].sigma_y);
+  }
+  return hash;
+}
+
+uint64_t FeatureCache::rotation_key(uint64_t source_key, const Texture& rotation, bool derived)
+{
+  uint64_t hash = fnv1a(source_key, rotation.angle_rad);
+  hash = fnv1a(hash, rotation.texture.rows);
+  hash = fnv1a(hash, rotation.texture.cols);
+  return fnv1a(hash, derived);
+}
+
+fs::path FeatureCache::path(uint64_t key) const
+{
+  return m_directory / (boost::format("%016x.trfeat") % key).str();
+}
+
+bool FeatureCache::load(uint64_t key, Texture& texture) const
+{
+  const fs::path path_key = path(key);
+  if (!fs::exists(path_key))
+  {
+    return false;
+  }
+
+  try
+  {
+    bip::file_mapping file(path_key.string().c_str(), bip::read_only);
+    bip::mapped_region region(file, bip::read_only);
+    const unsigned char* data = static_cast<const unsigned char*>(region.get_address());
+    if (region.get_size() < sizeof(FeatureCacheHeader))
+    {
+      return false;
+    }
+
+    FeatureCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const size_t pixels = static_cast<size_t>(header.rows) * header.cols;
+    if (std::memcmp(header.magic, feature_cache_magic, sizeof(header.magic)) != 0 || header.key != key ||
+      header.rows != texture.texture.rows || header.cols != texture.texture.cols || header.num_channels <= 0 ||
+      region.get_size() != sizeof(header) + pixels * (header.num_channels * sizeof(uint16_t) + 1))
+    {
+      return false;
+    }
+
+    const unsigned char* ptr = data + sizeof(header);
+    std::vector<cv::Mat> channels(header.num_channels);
+    for (cv::Mat& channel : channels)
+    {
+      channel = cv::Mat(header.rows, header.cols, CV_16UC1, const_cast<unsigned char*>(ptr)).clone();
+      ptr += pixels * sizeof(uint16_t);
+    }
+    texture.response = FeatureVector(channels);
+    texture.mask_rotation = cv::Mat(header.rows, header.cols, CV_8UC1, const_cast<unsigned char*>(ptr)).clone();
+    texture.transformation_matrix = cv::Mat(2, 3, CV_64FC1, header.transformation_matrix).clone();
+    cv::invertAffineTransform(texture.transformation_matrix, texture.transformation_matrix_inv);
+  }
+  catch (const bip::interprocess_exception& e)
+  {
+    std::cerr << "WARNING: Unable to read feature cache file " << path_key << ": " << e.what() << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+void FeatureCache::store(uint64_t key, const Texture& texture) const
+{
+  const FeatureVector& response = texture.response;
+  if (response.num_channels() == 0 || response.size() != texture.texture.size() ||
+    texture.mask_rotation.type() != CV_8UC1 || texture.mask_rotation.size() != texture.texture.size())
+  {
+    return;
+  }
+
+  FeatureCacheHeader header;
+  std::memcpy(header.magic, feature_cache_magic, sizeof(header.magic));
+  header.key = key;
+  header.rows = response.rows();
+  header.cols = response.cols();
+  header.num_channels = response.num_channels();
+  header.reserved = 0;
+  cv::Mat transformation_matrix;
+  texture.transformation_matrix.convertTo(transformation_matrix, CV_64FC1);
+  std::memcpy(header.transformation_matrix, transformation_matrix.ptr<double>(), sizeof(header.transformation_matrix));
+
+  const fs::path path_key = path(key);
+  const fs::path path_temp = m_directory / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+  {
+    std::ofstream file(path_temp.string(), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int i = 0; i < response.num_channels(); ++i)
+    {
+      const cv::Mat channel = response[i];
+      for (int y = 0; y < channel.rows; ++y)
+      {
+        file.write(channel.ptr<char>(y), channel.cols * sizeof(uint16_t));
+      }
+    }
+    for (int y = 0; y < texture.mask_rotation.rows; ++y)
+    {
+      file.write(texture.mask_rotation.ptr<char>(y), texture.mask_rotation.cols);
+    }
+
+    if (!file)
+    {
+      std::cerr << "WARNING: Unable to write feature cache file " << path_key << std::endl;
+      file.close();
+      fs::remove(path_temp);
+      return;
+    }
+  }
+
+  boost::system::error_code error;
+  fs::rename(path_temp, path_key, error);
+  if (error)
+  {
+    fs::remove(path_temp, error);
+  }
+}
@@ -0,0 +1,81 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_FEATURE_CACHE_HPP_
+#define TRLIB_FEATURE_CACHE_HPP_
+
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "feature_evaluator.hpp"
+#include "texture.hpp"
+
+/*
+ * On-disk cache of source texture features, one file per texture rotation,
+ * addressed by a hash of everything the features depend on. A file holds a
+ * fixed header with the transformation matrix, the CV_16U feature channels
+ * and the eroded rotation mask, contiguous and uncompressed, so it is read
+ * through a memory mapping. Files are written under a temporary name and
+ * renamed, so concurrent runs sharing a directory never read partial files.
+ */
+class FeatureCache
+{
+public:
+  FeatureCache() = default;
+  explicit FeatureCache(const boost::filesystem::path& directory);
+
+  bool enabled() const
+  {
+    return !m_directory.empty();
+  }
+
+  /*
+   * Hash of the unrotated source: image and mask bytes, scale, dpi, filter
+   * bank and feature weights. Computed once per texture before its masks are
+   * eroded.
+   */
+  static uint64_t source_key(const FeatureEvaluator& evaluator, const Texture& source);
+
+  /*
+   * Key of one rotation of a source. derived marks features derived with
+   * FeatureEvaluator::rotate_response instead of evaluated.
+   */
+  static uint64_t rotation_key(uint64_t source_key, const Texture& rotation, bool derived);
+
+  /*
+   * Replaces response, mask_rotation and the transformation matrices of
+   * texture with the entry for key. Returns false on a miss or a file that
+   * does not match the texture.
+   */
+  bool load(uint64_t key, Texture& texture) const;
+
+  void store(uint64_t key, const Texture& texture) const;
+
+  boost::filesystem::path path(uint64_t key) const;
+
+private:
+  boost::filesystem::path m_directory;
+};
+
+#endif /* TRLIB_FEATURE_CACHE_HPP_ */
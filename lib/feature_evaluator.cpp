@@ -26,7 +26,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "feature_evaluator.hpp"
 
+#include <cmath>
+#include <stdexcept>
+
+#include <boost/math/constants/constants.hpp>
+
 #include "histogram.hpp"
+#include "intensity_sobel.hpp"
 
 FeatureVector FeatureEvaluator::evaluate(cv::Mat texture, cv::Mat mask) const
 {
@@ -36,27 +42,18 @@ FeatureVector FeatureEvaluator::evaluate(cv::Mat texture, cv::Mat mask) const
     gabor_response = m_filter_bank.compute_matches(texture);
   }
 
-  cv::Mat texture_conv;
-  cv::cvtColor(texture, texture_conv, cv::COLOR_BGR2GRAY);
+  cv::Mat intensity, sobel;
+  compute_intensity_sobel(texture, m_weight_intensity, m_weight_sobel, intensity, sobel);
 
   std::vector<cv::Mat> response_vec;
   if (m_weight_intensity > 0.0)
   {
-    response_vec.push_back(m_weight_intensity * texture_conv);
+    response_vec.push_back(intensity);
   }
-  cv::Mat texture_float;
-  texture_conv.convertTo(texture_float, CV_32FC1, 1.0 / 65535.0);
-
-  cv::Mat texture_sobel_x, texture_sobel_y, texture_sobel_mag;
-  cv::Sobel(texture_float, texture_sobel_x, CV_32F, 1, 0);
-  cv::Sobel(texture_float, texture_sobel_y, CV_32F, 0, 1);
-  cv::magnitude(texture_sobel_x, texture_sobel_y, texture_sobel_mag);
-  texture_sobel_mag *= 0.25;
-  texture_sobel_mag.convertTo(texture_sobel_mag, CV_16UC1, 65535.0);
 
   if (m_weight_sobel > 0.0)
   {
-    response_vec.push_back(m_weight_sobel * texture_sobel_mag);
+    response_vec.push_back(sobel);
   }
 
   if (m_weight_gabor > 0.0)
@@ -76,18 +73,12 @@ FeatureVector FeatureEvaluator::evaluate_with_histogram_matching(cv::Mat texture
     gabor_response = m_filter_bank.compute_matches(texture);
   }
 
-  cv::Mat texture_gray;
-  cv::cvtColor(texture, texture_gray, cv::COLOR_BGR2GRAY);
+  // The unweighted gray image is needed for histogram matching.
+  cv::Mat texture_gray, sobel;
+  compute_intensity_sobel(texture, 1.0, m_weight_sobel, texture_gray, sobel);
 
   cv::Mat texture_float;
   texture_gray.convertTo(texture_float, CV_32FC1, 1.0/65535.0);
-
-  cv::Mat texture_sobel_x, texture_sobel_y, texture_sobel_mag;
-  cv::Sobel(texture_float, texture_sobel_x, CV_32F, 1, 0);
-  cv::Sobel(texture_float, texture_sobel_y, CV_32F, 0, 1);
-  cv::magnitude(texture_sobel_x, texture_sobel_y, texture_sobel_mag);
-  texture_sobel_mag *= 0.25;
-  texture_sobel_mag.convertTo(texture_sobel_mag, CV_16UC1, 65535.0);
   
   std::vector<cv::Mat> textures_target_gray(texture_target.size());
   for (size_t i = 0; i < texture_target.size(); ++i)
@@ -118,7 +109,7 @@ FeatureVector FeatureEvaluator::evaluate_with_histogram_matching(cv::Mat texture
 
   if (m_weight_sobel > 0.0)
   {
-    response_vec.push_back(m_weight_sobel * texture_sobel_mag);
+    response_vec.push_back(sobel);
   }
 
   if (m_weight_gabor > 0.0)
@@ -131,6 +122,76 @@ FeatureVector FeatureEvaluator::evaluate_with_histogram_matching(cv::Mat texture
   return FeatureVector(response_vec);
 }
 
+FeatureVector FeatureEvaluator::rotate_response(const FeatureVector& response, const cv::Mat& transformation_matrix, cv::Size size) const
+{
+  const double angle = std::atan2(transformation_matrix.at<double>(0, 1), transformation_matrix.at<double>(0, 0));
+  const FeatureVector shifted = rotate_orientations(response, angle, m_weight_gabor > 0.0 ? m_filter_bank.num_frequencies() : 0, m_filter_bank.num_directions());
+
+  std::vector<cv::Mat> channels_rotated(shifted.num_channels());
+  for (int i = 0; i < shifted.num_channels(); ++i)
+  {
+    cv::warpAffine(shifted[i], channels_rotated[i], transformation_matrix, size);
+  }
+
+  return FeatureVector(channels_rotated);
+}
+
+FeatureVector rotate_orientations(const FeatureVector& response, double angle, int num_frequencies, int num_directions)
+{
+  std::vector<cv::Mat> channels(response.num_channels());
+  for (int i = 0; i < response.num_channels(); ++i)
+  {
+    channels[i] = response[i];
+  }
+
+  const int num_gabor = num_frequencies * num_directions;
+  if (num_gabor > response.num_channels())
+  {
+    throw(std::invalid_argument("rotate_orientations: response has fewer channels than the filter bank."));
+  }
+
+  if (num_gabor > 0 && num_directions > 1)
+  {
+    // Rotation angle in units of the direction spacing, wrapped to [0, num_directions).
+    const double pi = boost::math::constants::pi<double>();
+    double shift = angle * num_directions / pi;
+    shift -= num_directions * std::floor(shift / num_directions);
+
+    int shift_directions = static_cast<int>(std::floor(shift));
+    double weight = shift - shift_directions;
+    if (weight > 1.0 - 1e-6)
+    {
+      ++shift_directions;
+      weight = 0.0;
+    }
+    else if (weight < 1e-6)
+    {
+      weight = 0.0;
+    }
+
+    const int gabor_begin = response.num_channels() - num_gabor;
+    for (int f = 0; f < num_frequencies; ++f)
+    {
+      const int frequency_begin = gabor_begin + f * num_directions;
+      for (int d = 0; d < num_directions; ++d)
+      {
+        const cv::Mat channel_0 = response[frequency_begin + (d + shift_directions) % num_directions];
+        if (weight == 0.0)
+        {
+          channels[frequency_begin + d] = channel_0;
+        }
+        else
+        {
+          const cv::Mat channel_1 = response[frequency_begin + (d + shift_directions + 1) % num_directions];
+          cv::addWeighted(channel_0, 1.0 - weight, channel_1, weight, 0.0, channels[frequency_begin + d]);
+        }
+      }
+    }
+  }
+
+  return FeatureVector(channels);
+}
+
 struct HistogramMean
 {
   float add(int x, int y, float val)
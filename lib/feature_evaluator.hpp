@@ -45,8 +45,40 @@ public:
   FeatureVector evaluate(cv::Mat texture, cv::Mat mask=cv::Mat()) const;
   FeatureVector evaluate_with_histogram_matching(cv::Mat texture, const std::vector<Texture>& texture_target, cv::Mat mask, double dampening_factor) const;
 
+  /*
+   * Features of a rotated texture copy derived from the features of the
+   * unrotated texture, instead of evaluating the rotated copy. Channels are
+   * warped with transformation_matrix (unrotated to rotated coordinates) to
+   * size. Intensity and Sobel magnitude are rotation invariant, while Gabor
+   * direction theta of the rotated copy is direction theta + angle of the
+   * unrotated texture, so orientation channels are shifted cyclically. Angles
+   * that are no multiple of pi / num_directions blend the two neighbouring
+   * directions linearly, which only approximates the steered response.
+   */
+  FeatureVector rotate_response(const FeatureVector& response, const cv::Mat& transformation_matrix, cv::Size size) const;
+
   HistogramVector compute_feature_histogram(const FeatureVector& feature_vec, const cv::Size& patch_size) const;
 
+  double weight_intensity() const
+  {
+    return m_weight_intensity;
+  }
+
+  double weight_sobel() const
+  {
+    return m_weight_sobel;
+  }
+
+  double weight_gabor() const
+  {
+    return m_weight_gabor;
+  }
+
+  const GaborFilterBank& filter_bank() const
+  {
+    return m_filter_bank;
+  }
+
   cv::Size max_filter_size() const
   {
     cv::Size filter_size(1, 1);
@@ -63,10 +95,36 @@ public:
     return filter_size;
   }
 
+  /*
+   * Rough peak working memory of evaluate() on a texture of the given size:
+   * the channel stack with its weighted copies, the Sobel images and, with
+   * Gabor features, the padded gray image of GaborFilterBank::compute_matches.
+   */
+  double working_set_bytes(cv::Size size) const
+  {
+    const double pixels = static_cast<double>(size.area());
+    double bytes = pixels * (4.0 * m_num_channels + 16.0);
+    if (m_weight_gabor > 0.0)
+    {
+      const cv::Size border = m_filter_bank.max_filter_size();
+      bytes += 8.0 * (size.width + 2.0 * border.width) * (size.height + 2.0 * border.height);
+    }
+    return bytes;
+  }
+
 private:
   double m_weight_intensity, m_weight_sobel, m_weight_gabor;
   const GaborFilterBank& m_filter_bank;
   int m_num_channels;
 };
 
+/*
+ * Gabor orientation channels of response, the last num_frequencies blocks of
+ * num_directions channels, shifted cyclically so that direction theta of the
+ * result is direction theta + angle of response. Angles that are no multiple
+ * of pi / num_directions blend the two neighbouring directions linearly. All
+ * other channels are passed through.
+ */
+FeatureVector rotate_orientations(const FeatureVector& response, double angle, int num_frequencies, int num_directions);
+
 #endif /* TRLIB_FEATURE_EVALUATOR_HPP_ */
\ No newline at end of file
@@ -0,0 +1,117 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "feature_spectrum.hpp"
+
+#include <stdexcept>
+
+FeatureSpectrum::FeatureSpectrum(const FeatureVector& features, cv::Size dft_size) :
+  size(features.size())
+{
+  if (dft_size.width < size.width || dft_size.height < size.height)
+  {
+    throw(std::invalid_argument("FeatureSpectrum: DFT size smaller than feature size."));
+  }
+
+  const int num_channels = features.num_channels();
+  std::vector<cv::Mat> channels_float(num_channels);
+  spectra.resize(num_channels);
+
+#pragma omp parallel for
+  for (int i = 0; i < num_channels; ++i)
+  {
+    cv::Mat channel_padded = cv::Mat::zeros(dft_size, CV_32FC1);
+    channels_float[i] = channel_padded(cv::Rect(cv::Point(0, 0), size));
+    features.channel_float(i).copyTo(channels_float[i]);
+    cv::dft(channel_padded, spectra[i], 0, size.height);
+  }
+
+  cv::Mat energy_sum = cv::Mat::zeros(size, CV_64FC1);
+  for (const cv::Mat& channel : channels_float)
+  {
+    cv::accumulateSquare(channel, energy_sum);
+  }
+  cv::integral(energy_sum, energy_integral, CV_64F);
+}
+
+cv::Size FeatureSpectrum::optimal_dft_size(cv::Size size)
+{
+  return cv::Size(cv::getOptimalDFTSize(size.width), cv::getOptimalDFTSize(size.height));
+}
+
+double FeatureSpectrum::energy(const cv::Rect& rect) const
+{
+  return energy_integral.at<double>(rect.y + rect.height, rect.x + rect.width) -
+    energy_integral.at<double>(rect.y, rect.x + rect.width) -
+    energy_integral.at<double>(rect.y + rect.height, rect.x) +
+    energy_integral.at<double>(rect.y, rect.x);
+}
+
+cv::Mat sqdiff_fft(const FeatureSpectrum& texture, const FeatureSpectrum& kernel)
+{
+  if (texture.dft_size() != kernel.dft_size() || texture.num_channels() != kernel.num_channels())
+  {
+    throw(std::invalid_argument("sqdiff_fft: Texture and kernel spectra do not match."));
+  }
+
+  const int rows_out = texture.size.height - kernel.size.height + 1;
+  const int cols_out = texture.size.width - kernel.size.width + 1;
+
+  if (rows_out <= 0 || cols_out <= 0)
+  {
+    throw(std::invalid_argument("sqdiff_fft: Kernel larger than texture."));
+  }
+
+  /*
+   * Cross correlation of all channels, accumulated in the frequency domain.
+   */
+  cv::Mat spectrum_sum = cv::Mat::zeros(texture.dft_size(), CV_32FC1);
+  cv::Mat spectrum_product;
+  for (int i = 0; i < texture.num_channels(); ++i)
+  {
+    cv::mulSpectrums(texture.spectra[i], kernel.spectra[i], spectrum_product, 0, true);
+    spectrum_sum += spectrum_product;
+  }
+
+  cv::Mat correlation;
+  cv::dft(spectrum_sum, correlation, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT, rows_out);
+
+  /*
+   * sum (I-K)^2 = sum I^2 - 2 sum I*K + sum K^2
+   */
+  const cv::Mat& s = texture.energy_integral;
+  const int kw = kernel.size.width;
+  const int kh = kernel.size.height;
+  cv::Mat energy_window =
+    s(cv::Rect(kw, kh, cols_out, rows_out)) - s(cv::Rect(0, kh, cols_out, rows_out)) -
+    s(cv::Rect(kw, 0, cols_out, rows_out)) + s(cv::Rect(0, 0, cols_out, rows_out));
+
+  cv::Mat match;
+  energy_window.convertTo(match, CV_32FC1, 1.0, kernel.energy());
+  match -= 2.0 * correlation(cv::Rect(0, 0, cols_out, rows_out));
+
+  return cv::max(match, 0.0);
+}
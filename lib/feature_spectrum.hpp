@@ -0,0 +1,82 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_FEATURE_SPECTRUM_HPP_
+#define TRLIB_FEATURE_SPECTRUM_HPP_
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "feature_vector.hpp"
+
+/*
+ * Frequency domain representation of a multi-channel feature stack.
+ *
+ * The spectra of all channels are stored at a common (zero padded) DFT size,
+ * so that a multi-channel SQDIFF match reduces to one spectrum product per
+ * channel, accumulated in the frequency domain, and a single inverse DFT.
+ * The energy term sum_c I_c^2 is kept as an integral image for box sums.
+ */
+class FeatureSpectrum
+{
+public:
+  FeatureSpectrum() = default;
+  FeatureSpectrum(const FeatureVector& features, cv::Size dft_size);
+
+  static cv::Size optimal_dft_size(cv::Size size);
+
+  bool empty() const
+  {
+    return spectra.empty();
+  }
+
+  int num_channels() const
+  {
+    return static_cast<int>(spectra.size());
+  }
+
+  cv::Size dft_size() const
+  {
+    return empty() ? cv::Size() : spectra.front().size();
+  }
+
+  double energy() const
+  {
+    return energy_integral.at<double>(size.height, size.width);
+  }
+
+  double energy(const cv::Rect& rect) const;
+
+  std::vector<cv::Mat> spectra;
+  cv::Mat energy_integral;
+  cv::Size size;
+};
+
+/*
+ * Multi-channel SQDIFF of kernel over texture, equivalent to summing
+ * cv::matchTemplate(CV_TM_SQDIFF) over all channels. Both spectra have to share
+ * the same DFT size.
+ */
+cv::Mat sqdiff_fft(const FeatureSpectrum& texture, const FeatureSpectrum& kernel);
+
+#endif /* TRLIB_FEATURE_SPECTRUM_HPP_ */
@@ -35,8 +35,8 @@ namespace fs = boost::filesystem;
 
 void FeatureVector::render() const
 {
-  const cv::Size feature_size = feature_vector.front().size();
-  const int num_channels = static_cast<int>(feature_vector.size());
+  const cv::Size feature_size = size();
+  const int num_channels = this->num_channels();
   cv::Mat image_out = cv::Mat::zeros(feature_size, CV_8UC1);
 
   enum key_press
@@ -53,7 +53,7 @@ void FeatureVector::render() const
   while (run_visualization)
   {
     cv::Mat im_out;
-    feature_vector[cur_index].convertTo(im_out, CV_8UC1, 1.0/255);
+    (*this)[cur_index].convertTo(im_out, CV_8UC1, 1.0/255);
     cv::imshow("Response", im_out);
     int key = cv::waitKeyEx();
 
@@ -83,7 +83,7 @@ void FeatureVector::render() const
 
 void FeatureVector::save(const boost::filesystem::path& path) const
 {
-  const int num_channels = static_cast<int>(feature_vector.size());
+  const int num_channels = this->num_channels();
   cv::Mat image_out;
 
   if (!fs::exists(path))
@@ -98,7 +98,7 @@ void FeatureVector::save(const boost::filesystem::path& path) const
 
   for (int i = 0; i < num_channels; ++i)
   {
-    feature_vector[i].convertTo(image_out, CV_8UC1, 1.0 / 255.0);
+    (*this)[i].convertTo(image_out, CV_8UC1, 1.0 / 255.0);
     cv::imwrite((path / (boost::format("%04d.png") % i).str()).string(), image_out);
   }
 }
@@ -197,9 +197,11 @@ void FeatureVector::render(const std::vector<FeatureVector>& features)
 float FeatureVector::dist(cv::Point p_target, const FeatureVector& rhs, cv::Point p_rhs) const
 {
   float dist = 0.0f;
-  for (size_t i = 0; i < feature_vector.size(); ++i)
+  for (int i = 0; i < num_channels(); ++i)
   {
-    const float diff = (static_cast<float>(feature_vector[i].at<uint16_t>(p_target)) - static_cast<float>(rhs.feature_vector[i].at<uint16_t>(p_rhs))) / 65535.0f;
+    const float val_lhs = feature_vector.empty() ? feature_vector_float[i].at<float>(p_target) : static_cast<float>(feature_vector[i].at<uint16_t>(p_target)) / 65535.0f;
+    const float val_rhs = rhs.feature_vector.empty() ? rhs.feature_vector_float[i].at<float>(p_rhs) : static_cast<float>(rhs.feature_vector[i].at<uint16_t>(p_rhs)) / 65535.0f;
+    const float diff = val_lhs - val_rhs;
     dist += diff * diff;
   }
   return std::sqrt(dist);
@@ -212,15 +214,13 @@ cv::Mat FeatureVector::dist_sqr_mat(const FeatureVector& rhs) const
     throw(std::invalid_argument("FeatureVector sizes differ."));
   }
 
-  cv::Mat channel_lhs, channel_rhs, channel_diff;
+  cv::Mat channel_diff;
 
   cv::Mat dist = cv::Mat::zeros(size(), CV_32FC1);
 
   for (int i = 0; i < num_channels(); ++i)
   {
-    feature_vector[i].convertTo(channel_lhs, CV_32FC1, 1.0 / 65535.0);
-    rhs.feature_vector[i].convertTo(channel_rhs, CV_32FC1, 1.0 / 65535.0);
-    channel_diff = channel_lhs - channel_rhs;
+    channel_diff = channel_float(i) - rhs.channel_float(i);
     dist += channel_diff.mul(channel_diff);
   }
 
@@ -234,6 +234,21 @@ FeatureVector FeatureVector::clone() const
   {
     rhs.feature_vector.push_back(feature.clone());
   }
+  if (has_float_store())
+  {
+    if (feature_vector.empty())
+    {
+      for (const cv::Mat& feature : feature_vector_float)
+      {
+        rhs.feature_vector_float.push_back(allocate_aligned(feature.size()));
+        feature.copyTo(rhs.feature_vector_float.back());
+      }
+    }
+    else
+    {
+      rhs.compute_float_store();
+    }
+  }
   return rhs;
 }
 
@@ -243,4 +258,94 @@ void FeatureVector::downsample_nn(int factor)
   {
     cv::resize(feature, feature, cv::Size(), 1.0/factor, 1.0/factor, cv::INTER_NEAREST);
   }
-}
\ No newline at end of file
+  for (cv::Mat& feature : feature_vector_float)
+  {
+    cv::Mat feature_resized;
+    cv::resize(feature, feature_resized, cv::Size(), 1.0/factor, 1.0/factor, cv::INTER_NEAREST);
+    feature = allocate_aligned(feature_resized.size());
+    feature_resized.copyTo(feature);
+  }
+}
+
+void FeatureVector::update_weights(float weight_intensity, float weight_gabor, float weight_laplacian)
+{
+  const auto channel_weight = [&](int i)
+  {
+    return i == 0 ? weight_intensity : (i == 1 ? weight_laplacian : weight_gabor);
+  };
+
+  if (feature_vector.empty())
+  {
+    // Only float store left: scale and saturate like the CV_16U arithmetic would.
+    for (int i = 0; i < num_channels(); ++i)
+    {
+      feature_vector_float[i] *= channel_weight(i);
+      cv::min(feature_vector_float[i], 1.0, feature_vector_float[i]);
+    }
+    return;
+  }
+
+  for (int i = 0; i < num_channels(); ++i)
+  {
+    feature_vector[i] *= channel_weight(i);
+  }
+
+  if (has_float_store())
+  {
+    compute_float_store();
+  }
+}
+
+cv::Mat FeatureVector::allocate_aligned(cv::Size size)
+{
+  // Pad rows to a multiple of the alignment and add one alignment unit of
+  // slack, then return the ROI that starts at an aligned address. Since the
+  // buffer step is a multiple of the alignment, every row stays aligned.
+  const int floats_per_unit = static_cast<int>(float_store_alignment / sizeof(float));
+  const int cols_padded = ((size.width + floats_per_unit - 1) / floats_per_unit) * floats_per_unit;
+
+  cv::Mat buffer(size.height, cols_padded + floats_per_unit, CV_32FC1);
+  const size_t misalignment = reinterpret_cast<size_t>(buffer.data) % float_store_alignment;
+  const int offset = misalignment == 0 ? 0 : static_cast<int>((float_store_alignment - misalignment) / sizeof(float));
+
+  return buffer(cv::Rect(offset, 0, size.width, size.height));
+}
+
+void FeatureVector::compute_float_store()
+{
+  const int num_channels = static_cast<int>(feature_vector.size());
+  feature_vector_float.resize(num_channels);
+
+#pragma omp parallel for
+  for (int i = 0; i < num_channels; ++i)
+  {
+    feature_vector_float[i] = allocate_aligned(feature_vector[i].size());
+    feature_vector[i].convertTo(feature_vector_float[i], CV_32FC1, 1.0 / 65535.0);
+  }
+}
+
+void FeatureVector::release_float_store()
+{
+  feature_vector_float.clear();
+}
+
+void FeatureVector::release_u16()
+{
+  if (!has_float_store())
+  {
+    throw(std::logic_error("FeatureVector::release_u16: float store has not been computed."));
+  }
+  feature_vector.clear();
+}
+
+std::size_t FeatureVector::float_store_bytes() const
+{
+  return float_store_bytes(size(), num_channels());
+}
+
+std::size_t FeatureVector::float_store_bytes(cv::Size size, int num_channels)
+{
+  const size_t floats_per_unit = float_store_alignment / sizeof(float);
+  const size_t cols_padded = ((size.width + floats_per_unit - 1) / floats_per_unit + 1) * floats_per_unit;
+  return static_cast<size_t>(num_channels) * size.height * cols_padded * sizeof(float);
+}
@@ -23,6 +23,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef TRLIB_FEATURE_VECTOR_HPP_
 #define TRLIB_FEATURE_VECTOR_HPP_
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/filesystem.hpp>
@@ -47,34 +48,63 @@ public:
 
   int num_channels() const
   {
-    return static_cast<int>(feature_vector.size());
+    return static_cast<int>(std::max(feature_vector.size(), feature_vector_float.size()));
   }
 
   int rows() const
   {
-    return num_channels() > 0 ? feature_vector.front().rows : 0;
+    return size().height;
   }
 
   int cols() const
   {
-    return num_channels() > 0 ? feature_vector.front().cols : 0;
+    return size().width;
   }
 
   int depth() const
   {
-    return num_channels() > 0 ? feature_vector.front().depth() : -1;
+    return num_channels() > 0 ? CV_16U : -1;
   }
 
   cv::Size size() const
   {
-    return num_channels() > 0 ? feature_vector.front().size() : cv::Size();
+    if (!feature_vector.empty())
+    {
+      return feature_vector.front().size();
+    }
+    return feature_vector_float.empty() ? cv::Size() : feature_vector_float.front().size();
   }
 
+  /*
+   * Returns channel i as CV_16UC1. If the CV_16U copy has been released, the
+   * channel is converted back from the float store.
+   */
   cv::Mat operator[](int i) const
   {
+    if (feature_vector.empty())
+    {
+      cv::Mat feature;
+      feature_vector_float[i].convertTo(feature, CV_16UC1, 65535.0);
+      return feature;
+    }
     return feature_vector[i];
   }
 
+  /*
+   * Returns channel i as CV_32FC1 scaled to [0, 1]. Without float store, the
+   * channel is converted on the fly.
+   */
+  cv::Mat channel_float(int i) const
+  {
+    if (feature_vector_float.empty())
+    {
+      cv::Mat feature;
+      feature_vector[i].convertTo(feature, CV_32FC1, 1.0 / 65535.0);
+      return feature;
+    }
+    return feature_vector_float[i];
+  }
+
   FeatureVector operator()(const cv::Rect& region) const
   {
     FeatureVector result;
@@ -82,6 +112,10 @@ public:
     {
       result.feature_vector.push_back(feature(region));
     }
+    for (cv::Mat feature : feature_vector_float)
+    {
+      result.feature_vector_float.push_back(feature(region));
+    }
     return result;
   }
 
@@ -92,24 +126,43 @@ public:
     {
       result.feature_vector.push_back(feature(row_range, col_range));
     }
-    return result;
-  }
-
-  void update_weights(float weight_intensity, float weight_gabor, float weight_laplacian)
-  {
-    feature_vector[0] *= weight_intensity;
-    feature_vector[1] *= weight_laplacian;
-    for (int i = 2; i < num_channels(); ++i)
+    for (cv::Mat feature : feature_vector_float)
     {
-      feature_vector[i] *= weight_gabor;
+      result.feature_vector_float.push_back(feature(row_range, col_range));
     }
+    return result;
   }
 
+  void update_weights(float weight_intensity, float weight_gabor, float weight_laplacian);
+
   cv::Mat dist_sqr_mat(const FeatureVector& rhs) const;
 
   void downsample_nn(int factor);
 
+  /*
+   * Float store: planar CV_32FC1 copies of all channels, scaled to [0, 1], with
+   * 64 byte aligned rows. Matchers read from it instead of converting the
+   * CV_16U channels on every call.
+   */
+  void compute_float_store();
+  void release_float_store();
+  void release_u16();
+
+  bool has_float_store() const
+  {
+    return !feature_vector_float.empty();
+  }
+
+  std::size_t float_store_bytes() const;
+  static std::size_t float_store_bytes(cv::Size size, int num_channels);
+
+  static constexpr size_t float_store_alignment = 64;
+
   std::vector<cv::Mat> feature_vector;
+  std::vector<cv::Mat> feature_vector_float;
+
+private:
+  static cv::Mat allocate_aligned(cv::Size size);
 };
 
 #endif /* TRLIB_FEATURE_VECTOR_HPP_ */
\ No newline at end of file
@@ -30,9 +30,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <boost/math/constants/constants.hpp>
 
-cv::Mat GaborFilter::apply(cv::Mat texture) const
+cv::Mat gabor_gray(cv::Mat texture)
 {
-  cv::Mat response;
   cv::Mat texture_gray;
 
   if (texture.channels() == 3)
@@ -53,6 +52,14 @@ cv::Mat GaborFilter::apply(cv::Mat texture) const
     texture_gray.convertTo(texture_gray, CV_32FC1, 1.0 / 65535.0);
   }
 
+  return texture_gray;
+}
+
+cv::Mat GaborFilter::apply(cv::Mat texture) const
+{
+  cv::Mat response;
+  const cv::Mat texture_gray = gabor_gray(texture);
+
   cv::Mat response_real, response_imag;
   cv::filter2D(texture_gray, response_real, -1, kernel_real, cv::Point(-1, -1), 0.0, cv::BORDER_REFLECT_101);
   cv::filter2D(texture_gray, response_imag, -1, kernel_imag, cv::Point(-1, -1), 0.0, cv::BORDER_REFLECT_101);
@@ -46,6 +46,12 @@ struct GaborFilter
   int kernel_size_y;
 };
 
+/*
+ * Gray filter input of a texture: BGR is converted to gray, 8 and 16 bit
+ * depths are scaled to [0, 1] floats.
+ */
+cv::Mat gabor_gray(cv::Mat texture);
+
 double compute_sigma_x(double frequency, double bandwidth_frequency_octaves);
 double compute_sigma_y(double frequency, double bandwidth_angular);
 
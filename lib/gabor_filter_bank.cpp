@@ -26,11 +26,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "gabor_filter_bank.hpp"
 
+#include <algorithm>
+
 #include <boost/math/constants/constants.hpp>
 
 #include "linspace.hpp"
 
-GaborFilterBank::GaborFilterBank(int filter_resolution, double frequency_octaves, int num_directions)
+GaborFilterBank::GaborFilterBank(int filter_resolution, double frequency_octaves, int num_directions) :
+  m_kernel_spectra(std::make_shared<KernelSpectra>())
 {
   const double bandwidth_angular = boost::math::constants::pi<double>() / num_directions;
 
@@ -57,15 +60,112 @@ GaborFilterBank::GaborFilterBank(int filter_resolution, double frequency_octaves
   }
 }
 
+cv::Size GaborFilterBank::tile_size(cv::Size texture_size) const
+{
+  // The output part of a tile is at least four borders wide, so the overlap costs at most about half of each tile DFT.
+  // Textures smaller than that are transformed whole.
+  const cv::Size border = max_filter_size();
+  const int min_tile_output = 512;
+  return cv::Size(
+    cv::getOptimalDFTSize(std::min(texture_size.width, std::max(min_tile_output, 4 * border.width)) + 2 * border.width),
+    cv::getOptimalDFTSize(std::min(texture_size.height, std::max(min_tile_output, 4 * border.height)) + 2 * border.height));
+}
+
+const std::vector<cv::Mat>& GaborFilterBank::kernel_spectra(cv::Size tile_size) const
+{
+  std::lock_guard<std::mutex> lock(m_kernel_spectra->mutex);
+  std::vector<cv::Mat>& spectra = m_kernel_spectra->spectra[std::make_pair(tile_size.width, tile_size.height)];
+  if (spectra.empty())
+  {
+    for (int i = 0; i < m_gabor_filters.size(); ++i)
+    {
+      const GaborFilter& filter = m_gabor_filters[i];
+
+      cv::Mat kernel_complex;
+      const cv::Mat kernel_planes[] = {filter.kernel_real, filter.kernel_imag};
+      cv::merge(kernel_planes, 2, kernel_complex);
+
+      cv::Mat kernel_spectrum = cv::Mat::zeros(tile_size, CV_32FC2);
+      kernel_complex.copyTo(kernel_spectrum(cv::Rect(0, 0, kernel_complex.cols, kernel_complex.rows)));
+      cv::dft(kernel_spectrum, kernel_spectrum, 0, kernel_complex.rows);
+      spectra.push_back(kernel_spectrum);
+    }
+  }
+  return spectra;
+}
+
 mat<cv::Mat> GaborFilterBank::compute_matches(cv::Mat texture) const
 {
   const double gabor_max = 0.2;
   mat<cv::Mat> response(m_gabor_filters.height(), m_gabor_filters.width());
+  if (m_gabor_filters.size() == 0 || texture.empty())
+  {
+    return response;
+  }
+
+  /*
+   * The gray texture is padded like cv::filter2D with BORDER_REFLECT_101 by
+   * the largest kernel and filtered in overlapping tiles of a bounded DFT
+   * size (overlap-save), so the kernel spectra are computed once per tile
+   * size instead of on every call. All
+   * filters share the forward DFT of a tile. Each filter then costs one
+   * spectrum product with its complex kernel (real + i * imag) and one
+   * inverse DFT, which yields both responses at once.
+   */
+  cv::Mat texture_gray = gabor_gray(texture);
+  if (texture_gray.depth() != CV_32F)
+  {
+    texture_gray.convertTo(texture_gray, CV_32F);
+  }
+
+  const cv::Size border = max_filter_size();
+  cv::Mat texture_padded;
+  cv::copyMakeBorder(texture_gray, texture_padded, border.height, border.height, border.width, border.width, cv::BORDER_REFLECT_101);
+
+  const cv::Size dft_size = tile_size(texture_gray.size());
+  const std::vector<cv::Mat>& kernel_spectrum = kernel_spectra(dft_size);
+  const cv::Size tile_output(dft_size.width - 2 * border.width, dft_size.height - 2 * border.height);
+  const int num_tiles_x = (texture_gray.cols + tile_output.width - 1) / tile_output.width;
+  const int num_tiles_y = (texture_gray.rows + tile_output.height - 1) / tile_output.height;
+
   for (int i = 0; i < m_gabor_filters.size(); ++i)
   {
-    response[i] = m_gabor_filters[i].apply(texture);
-    response[i] = cv::min(response[i], gabor_max) / gabor_max;
-    response[i].convertTo(response[i], CV_16UC1, 65535.0);
+    response[i].create(texture_gray.size(), CV_16UC1);
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int tile = 0; tile < num_tiles_x * num_tiles_y; ++tile)
+  {
+    const int x = (tile % num_tiles_x) * tile_output.width;
+    const int y = (tile / num_tiles_x) * tile_output.height;
+    const cv::Rect output(x, y, std::min(tile_output.width, texture_gray.cols - x), std::min(tile_output.height, texture_gray.rows - y));
+    const cv::Rect input(x, y, output.width + 2 * border.width, output.height + 2 * border.height);
+
+    // Outputs only read input up to two borders past them, so the circular wrap of the tile DFT never reaches them.
+    cv::Mat tile_dft = cv::Mat::zeros(dft_size, CV_32FC1);
+    texture_padded(input).copyTo(tile_dft(cv::Rect(0, 0, input.width, input.height)));
+    cv::Mat tile_spectrum;
+    cv::dft(tile_dft, tile_spectrum, cv::DFT_COMPLEX_OUTPUT, input.height);
+
+    for (int i = 0; i < m_gabor_filters.size(); ++i)
+    {
+      const GaborFilter& filter = m_gabor_filters[i];
+
+      // Correlating with the conjugate kernel only flips the sign of the imaginary response, which the magnitude ignores.
+      cv::Mat response_complex;
+      cv::mulSpectrums(tile_spectrum, kernel_spectrum[i], response_complex, 0, true);
+
+      const cv::Rect roi(border.width - filter.kernel_size_x, border.height - filter.kernel_size_y, output.width, output.height);
+      cv::dft(response_complex, response_complex, cv::DFT_INVERSE | cv::DFT_SCALE, roi.y + roi.height);
+
+      cv::Mat response_planes[2];
+      cv::split(response_complex(roi), response_planes);
+      cv::Mat response_tile;
+      cv::magnitude(response_planes[0], response_planes[1], response_tile);
+
+      response_tile = cv::min(response_tile, gabor_max) / gabor_max;
+      response_tile.convertTo(response[i](output), CV_16UC1, 65535.0);
+    }
   }
   return response;
 }
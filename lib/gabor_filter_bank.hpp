@@ -23,6 +23,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef TRLIB_GABOR_FILTER_BANK_HPP_
 #define TRLIB_GABOR_FILTER_BANK_HPP_
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 #include <opencv2/opencv.hpp>
 
 #include "gabor_filter.hpp"
@@ -58,7 +64,22 @@ public:
   cv::Size max_filter_size() const;
 
 private:
+  /*
+   * Spectra of the complex kernels (real + i * imag) per tile DFT size of
+   * compute_matches. They are computed on first use and shared by copies of
+   * the bank.
+   */
+  struct KernelSpectra
+  {
+    std::mutex mutex;
+    std::map<std::pair<int, int>, std::vector<cv::Mat>> spectra;
+  };
+
+  cv::Size tile_size(cv::Size texture_size) const;
+  const std::vector<cv::Mat>& kernel_spectra(cv::Size tile_size) const;
+
   mat<GaborFilter> m_gabor_filters;
+  std::shared_ptr<KernelSpectra> m_kernel_spectra;
 };
 
 #endif /* TRLIB_GABOR_FILTER_BANK_HPP_ */
\ No newline at end of file
@@ -0,0 +1,246 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "intensity_sobel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+// Fixed point BGR to gray weights of cv::cvtColor for 16 bit images.
+static const uint32_t gray_shift = 14;
+static const uint32_t gray_b = 1868;
+static const uint32_t gray_g = 9617;
+static const uint32_t gray_r = 4899;
+
+static int reflect_101(int i, int size)
+{
+  if (size == 1)
+  {
+    return 0;
+  }
+  return i < 0 ? -i : (i >= size ? 2 * size - 2 - i : i);
+}
+
+/*
+ * Gray values of texture row y into row[1..cols], with the reflected
+ * neighbours in row[0] and row[cols + 1].
+ */
+static void gray_row(const cv::Mat& texture, int y, int32_t* row)
+{
+  const int cols = texture.cols;
+  const uint16_t* src = texture.ptr<uint16_t>(y);
+  int32_t* dst = row + 1;
+  int x = 0;
+  if (texture.channels() == 3)
+  {
+#if CV_SIMD128
+    // The weighted sum of three 16 bit values stays below 2^30, so it is formed in unsigned 32 bit lanes.
+    const cv::v_uint32x4 w_b = cv::v_setall_u32(gray_b);
+    const cv::v_uint32x4 w_g = cv::v_setall_u32(gray_g);
+    const cv::v_uint32x4 w_r = cv::v_setall_u32(gray_r);
+    const cv::v_uint32x4 round = cv::v_setall_u32(1u << (gray_shift - 1));
+    for (; x <= cols - 8; x += 8)
+    {
+      cv::v_uint16x8 b, g, r;
+      cv::v_load_deinterleave(src + 3 * x, b, g, r);
+
+      cv::v_uint32x4 b_lo, b_hi, g_lo, g_hi, r_lo, r_hi;
+      cv::v_expand(b, b_lo, b_hi);
+      cv::v_expand(g, g_lo, g_hi);
+      cv::v_expand(r, r_lo, r_hi);
+      const cv::v_uint32x4 gray_lo = cv::v_shr<gray_shift>(b_lo * w_b + g_lo * w_g + r_lo * w_r + round);
+      const cv::v_uint32x4 gray_hi = cv::v_shr<gray_shift>(b_hi * w_b + g_hi * w_g + r_hi * w_r + round);
+      cv::v_store(dst + x, cv::v_reinterpret_as_s32(gray_lo));
+      cv::v_store(dst + x + 4, cv::v_reinterpret_as_s32(gray_hi));
+    }
+#endif
+    for (; x < cols; ++x)
+    {
+      const uint32_t sum = src[3 * x] * gray_b + src[3 * x + 1] * gray_g + src[3 * x + 2] * gray_r;
+      dst[x] = static_cast<int32_t>((sum + (1u << (gray_shift - 1))) >> gray_shift);
+    }
+  }
+  else
+  {
+#if CV_SIMD128
+    for (; x <= cols - 8; x += 8)
+    {
+      cv::v_uint32x4 gray_lo, gray_hi;
+      cv::v_expand(cv::v_load(src + x), gray_lo, gray_hi);
+      cv::v_store(dst + x, cv::v_reinterpret_as_s32(gray_lo));
+      cv::v_store(dst + x + 4, cv::v_reinterpret_as_s32(gray_hi));
+    }
+#endif
+    for (; x < cols; ++x)
+    {
+      dst[x] = src[x];
+    }
+  }
+
+  row[0] = dst[reflect_101(-1, cols)];
+  row[cols + 1] = dst[reflect_101(cols, cols)];
+}
+
+/*
+ * Weighted intensity of the padded gray row (gray[1..cols]), rounded like
+ * cv::saturate_cast<uint16_t>(float).
+ */
+static void intensity_row(const int32_t* gray, int cols, float scale, uint16_t* dst)
+{
+  int x = 0;
+#if CV_SIMD128
+  const cv::v_float32x4 v_scale = cv::v_setall_f32(scale);
+  for (; x <= cols - 8; x += 8)
+  {
+    const cv::v_int32x4 lo = cv::v_round(cv::v_cvt_f32(cv::v_load(gray + x + 1)) * v_scale);
+    const cv::v_int32x4 hi = cv::v_round(cv::v_cvt_f32(cv::v_load(gray + x + 5)) * v_scale);
+    cv::v_store(dst + x, cv::v_pack_u(lo, hi));
+  }
+#endif
+  for (; x < cols; ++x)
+  {
+    dst[x] = cv::saturate_cast<uint16_t>(gray[x + 1] * scale);
+  }
+}
+
+#if CV_SIMD128
+/*
+ * Weighted Sobel magnitudes at the four positions starting at the padded
+ * rows, before the final saturation to 16 bit.
+ */
+static inline cv::v_int32x4 sobel_lanes(const int32_t* prev, const int32_t* curr, const int32_t* next, const cv::v_float32x4& scale)
+{
+  const cv::v_int32x4 p0 = cv::v_load(prev), p1 = cv::v_load(prev + 1), p2 = cv::v_load(prev + 2);
+  const cv::v_int32x4 c0 = cv::v_load(curr), c2 = cv::v_load(curr + 2);
+  const cv::v_int32x4 n0 = cv::v_load(next), n1 = cv::v_load(next + 1), n2 = cv::v_load(next + 2);
+
+  const cv::v_int32x4 gx = (p2 - p0) + cv::v_shl<1>(c2 - c0) + (n2 - n0);
+  const cv::v_int32x4 gy = (n0 + cv::v_shl<1>(n1) + n2) - (p0 + cv::v_shl<1>(p1) + p2);
+  const cv::v_float32x4 fx = cv::v_cvt_f32(gx);
+  const cv::v_float32x4 fy = cv::v_cvt_f32(gy);
+  const cv::v_float32x4 magnitude = cv::v_setall_f32(0.25f) * cv::v_sqrt(fx * fx + fy * fy);
+
+  // The magnitude is non-negative, so saturating it to 16 bit only needs the upper bound.
+  const cv::v_int32x4 magnitude_u16 = cv::v_min(cv::v_round(magnitude), cv::v_setall_s32(65535));
+  return cv::v_round(cv::v_cvt_f32(magnitude_u16) * scale);
+}
+#endif
+
+/*
+ * Weighted Sobel magnitude of the padded gray row curr, with its neighbours
+ * prev and next.
+ */
+static void sobel_row(const int32_t* prev, const int32_t* curr, const int32_t* next, int cols, float scale, uint16_t* dst)
+{
+  int x = 0;
+#if CV_SIMD128
+  const cv::v_float32x4 v_scale = cv::v_setall_f32(scale);
+  for (; x <= cols - 8; x += 8)
+  {
+    const cv::v_int32x4 lo = sobel_lanes(prev + x, curr + x, next + x, v_scale);
+    const cv::v_int32x4 hi = sobel_lanes(prev + x + 4, curr + x + 4, next + x + 4, v_scale);
+    cv::v_store(dst + x, cv::v_pack_u(lo, hi));
+  }
+#endif
+  for (; x < cols; ++x)
+  {
+    const int32_t gx = (prev[x + 2] - prev[x]) + 2 * (curr[x + 2] - curr[x]) + (next[x + 2] - next[x]);
+    const int32_t gy = (next[x] + 2 * next[x + 1] + next[x + 2]) - (prev[x] + 2 * prev[x + 1] + prev[x + 2]);
+    const float magnitude = 0.25f * std::sqrt(static_cast<float>(gx) * gx + static_cast<float>(gy) * gy);
+    dst[x] = cv::saturate_cast<uint16_t>(cv::saturate_cast<uint16_t>(magnitude) * scale);
+  }
+}
+
+void compute_intensity_sobel(const cv::Mat& texture, double weight_intensity, double weight_sobel, cv::Mat& intensity, cv::Mat& sobel)
+{
+  if (texture.type() != CV_16UC3 && texture.type() != CV_16UC1)
+  {
+    throw(std::invalid_argument("compute_intensity_sobel: texture must be of type CV_16UC3 or CV_16UC1."));
+  }
+
+  const bool with_intensity = weight_intensity > 0.0;
+  const bool with_sobel = weight_sobel > 0.0;
+  intensity = with_intensity ? cv::Mat(texture.size(), CV_16UC1) : cv::Mat();
+  sobel = with_sobel ? cv::Mat(texture.size(), CV_16UC1) : cv::Mat();
+  if (texture.empty() || (!with_intensity && !with_sobel))
+  {
+    return;
+  }
+
+  // Weights are applied in float like cv::Mat::convertTo does for CV_16U.
+  const float scale_intensity = static_cast<float>(weight_intensity);
+  const float scale_sobel = static_cast<float>(weight_sobel);
+
+  const int rows = texture.rows;
+  const int cols = texture.cols;
+  const int tile_rows = 64;
+  const int num_tiles = (rows + tile_rows - 1) / tile_rows;
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int tile = 0; tile < num_tiles; ++tile)
+  {
+    const int y_begin = tile * tile_rows;
+    const int y_end = std::min(y_begin + tile_rows, rows);
+
+    // Rolling buffer of the gray rows y - 1, y and y + 1.
+    std::vector<int32_t> buffer(3 * (cols + 2));
+    int32_t* row_prev = buffer.data();
+    int32_t* row_curr = row_prev + cols + 2;
+    int32_t* row_next = row_curr + cols + 2;
+    gray_row(texture, reflect_101(y_begin - 1, rows), row_prev);
+    gray_row(texture, y_begin, row_curr);
+
+    for (int y = y_begin; y < y_end; ++y)
+    {
+      if (with_sobel)
+      {
+        gray_row(texture, reflect_101(y + 1, rows), row_next);
+      }
+
+      if (with_intensity)
+      {
+        intensity_row(row_curr, cols, scale_intensity, intensity.ptr<uint16_t>(y));
+      }
+
+      if (with_sobel)
+      {
+        sobel_row(row_prev, row_curr, row_next, cols, scale_sobel, sobel.ptr<uint16_t>(y));
+
+        std::swap(row_prev, row_curr);
+        std::swap(row_curr, row_next);
+      }
+      else if (y + 1 < y_end)
+      {
+        gray_row(texture, y + 1, row_curr);
+      }
+    }
+  }
+}
@@ -0,0 +1,46 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_INTENSITY_SOBEL_HPP_
+#define TRLIB_INTENSITY_SOBEL_HPP_
+
+#include <opencv2/opencv.hpp>
+
+/*
+ * Intensity and Sobel magnitude channels of a CV_16UC3 (BGR) or CV_16UC1
+ * texture in one pass, replacing
+ *
+ *   gray      = cvtColor(texture, COLOR_BGR2GRAY)
+ *   intensity = weight_intensity * gray
+ *   sobel     = weight_sobel * u16(65535 * 0.25 * |Sobel(gray / 65535)|)
+ *
+ * Rows are processed in tiles; each tile converts its rows to gray once
+ * into a rolling buffer of three padded rows (BORDER_REFLECT_101) that the
+ * 3x3 Sobel reads in integer arithmetic. The row loops use OpenCV's
+ * universal intrinsics where CV_SIMD128 is available. gray and intensity are
+ * bit-exact with the OpenCV chain, Sobel differs by at most one quantization
+ * step from float rounding; tools/intensity_sobel_parity checks both. A
+ * channel with a weight <= 0 is not computed and left empty.
+ */
+void compute_intensity_sobel(const cv::Mat& texture, double weight_intensity, double weight_sobel, cv::Mat& intensity, cv::Mat& sobel);
+
+#endif /* TRLIB_INTENSITY_SOBEL_HPP_ */
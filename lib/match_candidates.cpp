@@ -0,0 +1,150 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "match_candidates.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <stdexcept>
+
+std::vector<MatchCandidate> select_match_candidates(cv::Mat cost, cv::Mat valid, int num_candidates, int nms_radius, int texture_index, int texture_rot)
+{
+  if (cost.type() != CV_32FC1)
+  {
+    throw(std::invalid_argument("select_match_candidates: cost map must be of type CV_32FC1."));
+  }
+  if (!valid.empty() && (valid.type() != CV_8UC1 || valid.size() != cost.size()))
+  {
+    throw(std::invalid_argument("select_match_candidates: valid mask must be of type CV_8UC1 and match the cost map."));
+  }
+
+  std::vector<MatchCandidate> candidates;
+  if (num_candidates <= 0 || cost.empty())
+  {
+    return candidates;
+  }
+
+  // Positions skipped by the bounded kernels are left at FLT_MAX.
+  cv::Mat available = cost < FLT_MAX;
+  if (!valid.empty())
+  {
+    available.setTo(0, valid == 0);
+  }
+
+  const cv::Rect cost_rect(0, 0, cost.cols, cost.rows);
+  const int radius = std::max(nms_radius, 0);
+  for (int k = 0; k < num_candidates; ++k)
+  {
+    double min_cost = 0.0;
+    cv::Point min_pos(-1, -1);
+    cv::minMaxLoc(cost, &min_cost, 0, &min_pos, 0, available);
+    if (min_pos.x < 0 || min_pos.y < 0)
+    {
+      break;
+    }
+
+    candidates.push_back(MatchCandidate{texture_index, texture_rot, min_cost, min_pos});
+    available(cv::Rect(min_pos.x - radius, min_pos.y - radius, 2 * radius + 1, 2 * radius + 1) & cost_rect) = 0;
+  }
+
+  return candidates;
+}
+
+void merge_match_candidates(std::vector<MatchCandidate>& candidates, int num_candidates, int nms_radius)
+{
+  std::stable_sort(candidates.begin(), candidates.end(), [](const MatchCandidate& lhs, const MatchCandidate& rhs) { return lhs.cost < rhs.cost; });
+
+  std::vector<MatchCandidate> merged;
+  for (const MatchCandidate& candidate : candidates)
+  {
+    if (static_cast<int>(merged.size()) >= num_candidates)
+    {
+      break;
+    }
+
+    const bool suppressed = std::any_of(merged.begin(), merged.end(), [&](const MatchCandidate& m)
+    {
+      return m.texture_index == candidate.texture_index && m.texture_rot == candidate.texture_rot &&
+        std::abs(m.texture_pos.x - candidate.texture_pos.x) <= nms_radius &&
+        std::abs(m.texture_pos.y - candidate.texture_pos.y) <= nms_radius;
+    });
+
+    if (!suppressed)
+    {
+      merged.push_back(candidate);
+    }
+  }
+
+  candidates.swap(merged);
+}
+
+bool match_candidate_available(const cv::Mat& texture_mask, const cv::Mat& kernel_mask, cv::Point pos)
+{
+  const cv::Rect window(pos, kernel_mask.size());
+  if ((window & cv::Rect(0, 0, texture_mask.cols, texture_mask.rows)) != window)
+  {
+    return false;
+  }
+
+  const cv::Mat texture_window = texture_mask(window);
+  for (int y = 0; y < kernel_mask.rows; ++y)
+  {
+    const unsigned char* ptr_kernel = kernel_mask.ptr<unsigned char>(y);
+    const unsigned char* ptr_texture = texture_window.ptr<unsigned char>(y);
+    for (int x = 0; x < kernel_mask.cols; ++x)
+    {
+      if (ptr_kernel[x] && !ptr_texture[x])
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+uint64_t mask_hash(const cv::Mat& mask)
+{
+  // FNV-1a over the mask rows.
+  uint64_t hash = 14695981039346656037ull;
+  const size_t row_bytes = mask.cols * mask.elemSize();
+  for (int y = 0; y < mask.rows; ++y)
+  {
+    const unsigned char* ptr = mask.ptr<unsigned char>(y);
+    for (size_t i = 0; i < row_bytes; ++i)
+    {
+      hash = (hash ^ ptr[i]) * 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+RegionKey region_key(const PatchRegion& region)
+{
+  const cv::Rect box = region.bounding_box();
+  return RegionKey(region.target_index(), box.x, box.y, box.width, box.height, mask_hash(region.mask()));
+}
@@ -0,0 +1,80 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_MATCH_CANDIDATES_HPP_
+#define TRLIB_MATCH_CANDIDATES_HPP_
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "patch_region.hpp"
+
+/*
+ * A single matching position of a kernel in one rotation of a texture.
+ */
+struct MatchCandidate
+{
+  int texture_index;
+  int texture_rot;
+  double cost;
+  cv::Point texture_pos;
+};
+
+/*
+ * Extracts up to num_candidates local minima from a cost map, best first.
+ * Only positions with a non-zero entry in valid (if given) are considered and
+ * positions at FLT_MAX are treated as not evaluated. After a candidate has
+ * been taken, all positions within nms_radius (Chebyshev distance) are
+ * suppressed, so the candidates do not cluster around a single minimum. With
+ * num_candidates = 1 the result is the same as cv::minMaxLoc.
+ */
+std::vector<MatchCandidate> select_match_candidates(cv::Mat cost, cv::Mat valid, int num_candidates, int nms_radius, int texture_index, int texture_rot);
+
+/*
+ * Sorts candidates of several (texture, rotation) pairs by cost and keeps the
+ * num_candidates best. Suppression only applies between candidates of the same
+ * texture rotation, since positions of different rotations live in different
+ * coordinate frames.
+ */
+void merge_match_candidates(std::vector<MatchCandidate>& candidates, int num_candidates, int nms_radius);
+
+/*
+ * True if a kernel with the given mask placed at pos in a texture only covers
+ * pixels that are still available in texture_mask.
+ */
+bool match_candidate_available(const cv::Mat& texture_mask, const cv::Mat& kernel_mask, cv::Point pos);
+
+/*
+ * FNV-1a hash over the rows of a mask, used to identify region shapes.
+ */
+uint64_t mask_hash(const cv::Mat& mask);
+
+/*
+ * Identifies a patch region by target, bounding box and mask hash.
+ */
+typedef std::tuple<int, int, int, int, int, uint64_t> RegionKey;
+RegionKey region_key(const PatchRegion& region);
+
+#endif /* TRLIB_MATCH_CANDIDATES_HPP_ */
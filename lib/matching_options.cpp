@@ -0,0 +1,93 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "matching_options.hpp"
+
+namespace fs = boost::filesystem;
+namespace pt = boost::property_tree;
+
+MatchingOptions MatchingOptions::load(const pt::ptree& root, const fs::path& path_json)
+{
+  MatchingOptions options;
+  options.fft_matching = root.get<bool>("fft_matching", options.fft_matching);
+  options.feature_store_budget_mb = root.get<double>("feature_store_budget_mb", options.feature_store_budget_mb);
+  options.feature_store_drop_u16 = root.get<bool>("feature_store_drop_u16", options.feature_store_drop_u16);
+  options.feature_memory_budget_mb = root.get<double>("feature_memory_budget_mb", options.feature_memory_budget_mb);
+  options.feature_cache_dir = root.get<fs::path>("feature_cache_dir", options.feature_cache_dir);
+  if (!options.feature_cache_dir.empty() && options.feature_cache_dir.is_relative())
+  {
+    options.feature_cache_dir = path_json / options.feature_cache_dir;
+  }
+  options.matching_precision = matching_precision_from_string(root.get<std::string>("matching_precision", to_string(options.matching_precision)));
+  options.early_termination = root.get<bool>("early_termination", options.early_termination);
+  options.lower_bound_pruning = root.get<bool>("lower_bound_pruning", options.lower_bound_pruning);
+  options.pyramid_levels = root.get<int>("pyramid_levels", options.pyramid_levels);
+  options.pyramid_candidates = root.get<int>("pyramid_candidates", options.pyramid_candidates);
+  options.pyramid_refine_radius = root.get<int>("pyramid_refine_radius", options.pyramid_refine_radius);
+  options.pyramid_min_kernel_size = root.get<int>("pyramid_min_kernel_size", options.pyramid_min_kernel_size);
+  options.pyramid_exact = root.get<bool>("pyramid_exact", options.pyramid_exact);
+  options.num_match_candidates = root.get<int>("num_match_candidates", options.num_match_candidates);
+  options.match_candidate_nms_radius = root.get<int>("match_candidate_nms_radius", options.match_candidate_nms_radius);
+  options.rotate_kernel = root.get<bool>("rotate_kernel", options.rotate_kernel);
+  options.derive_rotated_features = root.get<bool>("derive_rotated_features", options.derive_rotated_features);
+  options.validity_cache_budget_mb = root.get<double>("validity_cache_budget_mb", options.validity_cache_budget_mb);
+  options.region_lookahead = root.get<int>("region_lookahead", options.region_lookahead);
+  options.speculative_matching = root.get<bool>("speculative_matching", options.speculative_matching);
+  options.local_refinement_radius = root.get<int>("local_refinement_radius", options.local_refinement_radius);
+  options.local_refinement_rotations = root.get<int>("local_refinement_rotations", options.local_refinement_rotations);
+  options.local_refinement_threshold = root.get<double>("local_refinement_threshold", options.local_refinement_threshold);
+  options.match_tile_rows = root.get<int>("match_tile_rows", options.match_tile_rows);
+  return options;
+}
+
+std::ostream& operator<<(std::ostream& os, const MatchingOptions& options)
+{
+  os << "fft_matching: " << (options.fft_matching ? "yes" : "no") << std::endl
+    << "feature_store_budget_mb: " << options.feature_store_budget_mb << std::endl
+    << "feature_store_drop_u16: " << (options.feature_store_drop_u16 ? "yes" : "no") << std::endl
+    << "feature_memory_budget_mb: " << options.feature_memory_budget_mb << std::endl
+    << "feature_cache_dir: " << options.feature_cache_dir << std::endl
+    << "matching_precision: " << to_string(options.matching_precision) << std::endl
+    << "early_termination: " << (options.early_termination ? "yes" : "no") << std::endl
+    << "lower_bound_pruning: " << (options.lower_bound_pruning ? "yes" : "no") << std::endl
+    << "pyramid_levels: " << options.pyramid_levels << std::endl
+    << "pyramid_candidates: " << options.pyramid_candidates << std::endl
+    << "pyramid_refine_radius: " << options.pyramid_refine_radius << std::endl
+    << "pyramid_min_kernel_size: " << options.pyramid_min_kernel_size << std::endl
+    << "pyramid_exact: " << (options.pyramid_exact ? "yes" : "no") << std::endl
+    << "num_match_candidates: " << options.num_match_candidates << std::endl
+    << "match_candidate_nms_radius: " << options.match_candidate_nms_radius << std::endl
+    << "rotate_kernel: " << (options.rotate_kernel ? "yes" : "no") << std::endl
+    << "derive_rotated_features: " << (options.derive_rotated_features ? "yes" : "no") << std::endl
+    << "validity_cache_budget_mb: " << options.validity_cache_budget_mb << std::endl
+    << "region_lookahead: " << options.region_lookahead << std::endl
+    << "speculative_matching: " << (options.speculative_matching ? "yes" : "no") << std::endl
+    << "local_refinement_radius: " << options.local_refinement_radius << std::endl
+    << "local_refinement_rotations: " << options.local_refinement_rotations << std::endl
+    << "local_refinement_threshold: " << options.local_refinement_threshold << std::endl
+    << "match_tile_rows: " << options.match_tile_rows << std::endl;
+  return os;
+}
@@ -0,0 +1,181 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_MATCHING_OPTIONS_HPP_
+#define TRLIB_MATCHING_OPTIONS_HPP_
+
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "sqdiff_kernels.hpp"
+
+/*
+ * Feature and matching settings of TreeMatch and TreeMatchGPU. Every member
+ * is read from the JSON key of the same name. The defaults run the exhaustive
+ * greedy search with all optimizations off.
+ */
+struct MatchingOptions
+{
+  /*
+   * Reads the settings from the root of a matcher JSON file. Missing keys keep
+   * their defaults, relative paths are resolved against path_json.
+   */
+  static MatchingOptions load(const boost::property_tree::ptree& root, const boost::filesystem::path& path_json);
+
+  // Match rectangular regions through the spectra of the texture features.
+  bool fft_matching = false;
+
+  /*
+   * Keep float copies of the feature channels for matching. The budget limits
+   * the memory spent on them (0 disables the store, negative is unlimited).
+   * With feature_store_drop_u16, the CV_16U channels of stored feature vectors
+   * are released; this is ignored with uint16 matching precision,
+   * rotate_kernel and OpenCL, which need them.
+   */
+  double feature_store_budget_mb = 0.0;
+  bool feature_store_drop_u16 = false;
+
+  /*
+   * compute_responses runs targets and textures as parallel tasks. The budget
+   * bounds the estimated working memory of the tasks running at once (0 is
+   * unlimited).
+   */
+  double feature_memory_budget_mb = 0.0;
+
+  // Directory of the on-disk cache of source texture features, see FeatureCache. Empty disables the cache.
+  boost::filesystem::path feature_cache_dir;
+
+  /*
+   * UInt16 matches all regions directly on the CV_16U channels, bypassing the
+   * float conversion, FFT and cv::matchTemplate paths.
+   */
+  MatchingPrecision matching_precision = MatchingPrecision::Float32;
+
+  /*
+   * Match all regions directly and abandon candidate positions as soon as
+   * their partial cost exceeds the best cost found by any worker so far.
+   */
+  bool early_termination = false;
+
+  /*
+   * Skip candidate positions whose lower bound from the texture integral images
+   * already exceeds the best cost found so far.
+   */
+  bool lower_bound_pruning = false;
+
+  /*
+   * Coarse-to-fine matching for kernels of at least pyramid_min_kernel_size
+   * pixels in both dimensions (0: largest patch size). pyramid_levels = 1
+   * disables it. With pyramid_exact, level 0 is searched exhaustively and
+   * pyramid misses are counted.
+   */
+  int pyramid_levels = 1;
+  int pyramid_candidates = 8;
+  int pyramid_refine_radius = 2;
+  int pyramid_min_kernel_size = 0;
+  bool pyramid_exact = false;
+
+  /*
+   * Keep the num_match_candidates best matches of each region searched ahead
+   * of its turn (see region_lookahead), suppressing matches within
+   * match_candidate_nms_radius pixels of a better one in the same texture
+   * rotation (negative: subpatch size). When the best match has been taken by
+   * the time the region comes up, the first later candidate that is still
+   * available is placed without a rematch. Positions suppressed around a
+   * consumed candidate are not reconsidered, so this is a heuristic; 1 keeps
+   * only the exact best match. early_termination and lower_bound_pruning are
+   * turned off with more than one candidate, since they leave the positions
+   * after the best one unevaluated.
+   */
+  int num_match_candidates = 1;
+  int match_candidate_nms_radius = -1;
+
+  /*
+   * Compute features only for the unrotated textures and match rotated copies
+   * of the target kernel against them, instead of matching the kernel against
+   * every rotated texture. Rotated textures keep their image and masks for
+   * placing patches.
+   */
+  bool rotate_kernel = false;
+
+  /*
+   * Derive the features of rotated textures from the unrotated texture with
+   * FeatureEvaluator::rotate_response instead of evaluating every rotated
+   * copy.
+   */
+  bool derive_rotated_features = false;
+
+  /*
+   * Keep the eroded texture masks per texture rotation and region shape and
+   * update them only where patches were placed or removed. The budget limits
+   * their memory (0 disables the cache, negative is unlimited).
+   */
+  double validity_cache_budget_mb = 0.0;
+
+  /*
+   * Search up to region_lookahead queued regions ahead of their turn (0
+   * disables) and place their matches without a new search as long as the
+   * matched source area is still available. Matches stay exact, see
+   * RegionScheduler. Requires speculative_matching: the lookahead only pays
+   * off when the regions are searched concurrently, while every region whose
+   * candidates were all taken by earlier placements is searched twice. Larger
+   * values search more regions in parallel, but also more that are searched
+   * again; more num_match_candidates avoid rematches at the price of
+   * exactness.
+   */
+  int region_lookahead = 0;
+
+  /*
+   * Search the lookahead regions, and the four finer regions of adaptive
+   * matching, concurrently against the current mask state instead of one after
+   * another. The regions are still placed in order and rematched when an
+   * earlier placement took their source area, so the result equals the serial
+   * greedy one.
+   */
+  bool speculative_matching = false;
+
+  /*
+   * Search the finer regions of adaptive matching first within
+   * local_refinement_radius pixels of their position in the parent's source
+   * area, in the parent's rotation and local_refinement_rotations neighboring
+   * rotations on each side. The global search is only run if the local cost
+   * per pixel exceeds local_refinement_threshold times the parent's cost per
+   * pixel. A radius of 0 disables it. Not used with rotated kernels.
+   */
+  int local_refinement_radius = 0;
+  int local_refinement_rotations = 1;
+  double local_refinement_threshold = 1.0;
+
+  /*
+   * Direct matches (non-rectangular regions, uint16 and bounded matching) are
+   * split into tiles of match_tile_rows cost map rows that are balanced over
+   * the threads. 0 matches every texture rotation as a single tile.
+   */
+  int match_tile_rows = 64;
+};
+
+// One "key: value" line per setting, as printed with the other settings by load.
+std::ostream& operator<<(std::ostream& os, const MatchingOptions& options);
+
+#endif /* TRLIB_MATCHING_OPTIONS_HPP_ */
@@ -1,4 +1,5 @@
 #include <matching_policies.hpp>
+#include <match_candidates.hpp>
 #include <simple_cl.hpp>
 #include <opencv2/opencv.hpp>
 #include <unordered_map>
@@ -102,6 +103,8 @@ namespace ocl_patch_matching
 					const Texture& kernel,
 					double texture_rotation
 				) const;
+
+				void set_num_matches(std::size_t num_matches, int nms_radius);
 				
 			private:
 				// --------------------------------- private types
@@ -162,6 +165,7 @@ namespace ocl_patch_matching
 					cv::Size response_dims;												///< Dimensions of the sqdiff response image.
 					simple_cl::cl::Program::ExecParams find_min_exec_params;			///< Kernel execution parameters for the find_min kernel.
 					std::size_t find_min_local_buffer_size;								///< Local buffer size for the find_min kernel.
+					cv::Mat texture_mask_eroded;										///< Eroded texture mask read back for host side match extraction.
 				};
 
 				/// Returns OpenCL image descriptor for an input texture.
@@ -307,6 +311,10 @@ namespace ocl_patch_matching
 				simple_cl::cl::Event read_eroded_texture_mask_image(cv::Mat& out_mat, const cv::Size& output_size, const std::vector<simple_cl::cl::Event>& wait_for, MatchingResourceSet& res);
 				/// Reads the partial minima from device memory and returns the global minimum.
 				void read_min_pos_and_cost(MatchingResult& res, const std::vector<simple_cl::cl::Event>& wait_for, const cv::Point& res_coord_offset, MatchingResourceSet& match_res);
+				/// Extracts the best m_num_matches matches from a cost matrix read back from the device. texture_mask may be empty.
+				void collect_matches(std::vector<MatchCandidate>& candidates, const cv::Mat& cost, const cv::Mat& texture_mask, const cv::Point& res_coord_offset, std::size_t rotation_index) const;
+				/// Merges the matches collected for all rotations into the result, sorted from best to worst.
+				void write_matches(MatchingResult& res, std::vector<MatchCandidate>& candidates) const;
 
 				// ------------------------------------------------------------ data members ----------------------------------------------------------------
 
@@ -327,6 +335,10 @@ namespace ocl_patch_matching
 				std::size_t m_local_buffer_max_pixels;
 				/// maximum number of matching passes to be pipelined (reduce gpu bubbles at the cost of memory overhead)
 				std::size_t m_max_pipelined_matching_passes;
+				/// number of matches returned per matching pass. more than one requires reading back the cost matrices
+				std::size_t m_num_matches;
+				/// minimum distance between two matches of the same rotation
+				int m_match_nms_radius;
 
 				// ---------------------------- OUTPUT RESOURCES ------------------------------------------
 
@@ -608,7 +620,9 @@ namespace ocl_patch_matching
 					m_result_origin{result_origin},
 					m_use_local_buffer_for_matching{use_local_buffer_for_matching},
 					m_use_local_buffer_for_erode{use_local_buffer_for_erode},
-					m_max_pipelined_matching_passes{max_pipelined_matching_passes}
+					m_max_pipelined_matching_passes{max_pipelined_matching_passes},
+					m_num_matches{1ull},
+					m_match_nms_radius{0}
 			{
 				if(!simple_cl::util::is_power_of_two(local_block_size) || local_block_size == 0ull)
 					throw std::invalid_argument("local_block_size must be a positive power of two.");
@@ -1398,6 +1412,40 @@ namespace ocl_patch_matching
 				res.matches.clear();
 				res.matches.push_back(Match{cv::Point(static_cast<int>(std::floorf(minimum.z)) + res_coord_offset.x, static_cast<int>(std::floorf(minimum.w)) + res_coord_offset.y), 0ull, minimum.x});				
 			}			
+
+			void ocl_patch_matching::matching_policies::impl::CLMatcherImpl::collect_matches(std::vector<MatchCandidate>& candidates, const cv::Mat& cost, const cv::Mat& texture_mask, const cv::Point& res_coord_offset, std::size_t rotation_index) const
+			{
+				// the find_min kernels sample the mask at the cost matrix position plus the kernel overlap, do the same here
+				cv::Mat valid;
+				if(!texture_mask.empty())
+				{
+					valid = texture_mask(cv::Rect(res_coord_offset, cost.size())) > 1e-6;
+				}
+				std::vector<MatchCandidate> rotation_candidates{select_match_candidates(cost, valid, static_cast<int>(m_num_matches), m_match_nms_radius, 0, static_cast<int>(rotation_index))};
+				for(MatchCandidate& candidate : rotation_candidates)
+				{
+					candidate.texture_pos += res_coord_offset;
+				}
+				candidates.insert(candidates.end(), rotation_candidates.begin(), rotation_candidates.end());
+			}
+
+			void ocl_patch_matching::matching_policies::impl::CLMatcherImpl::write_matches(MatchingResult& res, std::vector<MatchCandidate>& candidates) const
+			{
+				merge_match_candidates(candidates, static_cast<int>(m_num_matches), m_match_nms_radius);
+				if(candidates.empty())
+					return;
+				res.matches.clear();
+				for(const MatchCandidate& candidate : candidates)
+				{
+					res.matches.push_back(Match{candidate.texture_pos, static_cast<std::size_t>(candidate.texture_rot), candidate.cost});
+				}
+			}
+
+			inline void ocl_patch_matching::matching_policies::impl::CLMatcherImpl::set_num_matches(std::size_t num_matches, int nms_radius)
+			{
+				m_num_matches = std::max(num_matches, std::size_t{1ull});
+				m_match_nms_radius = std::max(nms_radius, 0);
+			}
 			
 			inline void ocl_patch_matching::matching_policies::impl::CLMatcherImpl::compute_matches(
 				const Texture& texture,
@@ -1421,6 +1469,7 @@ namespace ocl_patch_matching
 				match_res_out.matches.clear();
 				match_res_out.matches.push_back(Match{});
 				match_res_out.matches.back().match_cost = std::numeric_limits<double>::max();
+				std::vector<MatchCandidate> candidates;
 
 				// upload inputs
 				// input texture
@@ -1743,7 +1792,7 @@ namespace ocl_patch_matching
 					// read output and launch find min kernels
 					for(std::size_t r = 0ull; r < num_batch_rotations; ++r)
 					{
-						if(return_cost_matrix)
+						if(return_cost_matrix || m_num_matches > 1ull)
 						{
 							simple_cl::cl::Event response_finished_event{read_output_image(m_matching_resource_pool[r].sqdiff_result, m_matching_resource_pool[r].response_dims, m_matching_resource_pool[r].event_list, num_feature_batches % 2ull, m_matching_resource_pool[r])};
 							m_matching_resource_pool[r].event_list.clear();
@@ -1778,8 +1827,16 @@ namespace ocl_patch_matching
 							match_res_out.total_cost_matrix = m_matching_resource_pool[r].sqdiff_result;
 							match_res_out.matches[0].rotation_index = rotation_index;
 						}
+						if(m_num_matches > 1ull)
+						{
+							collect_matches(candidates, m_matching_resource_pool[r].sqdiff_result, cv::Mat(), result_offset, rotation_index);
+						}
 					}
 				}
+				if(m_num_matches > 1ull)
+				{
+					write_matches(match_res_out, candidates);
+				}
 			}
 
 			inline void ocl_patch_matching::matching_policies::impl::CLMatcherImpl::compute_matches(
@@ -1803,6 +1860,7 @@ namespace ocl_patch_matching
 				match_res_out.matches.clear();
 				match_res_out.matches.push_back(Match{});
 				match_res_out.matches.back().match_cost = std::numeric_limits<double>::max();
+				std::vector<MatchCandidate> candidates;
 
 				// upload inputs
 				// input texture
@@ -2114,7 +2172,7 @@ namespace ocl_patch_matching
 					// read output and launch find min kernels
 					for(std::size_t r = 0ull; r < num_batch_rotations; ++r)
 					{
-						if(return_cost_matrix)
+						if(return_cost_matrix || m_num_matches > 1ull)
 						{
 							simple_cl::cl::Event response_finished_event{read_output_image(m_matching_resource_pool[r].sqdiff_result, m_matching_resource_pool[r].response_dims, m_matching_resource_pool[r].event_list, num_feature_batches % 2ull, m_matching_resource_pool[r])};
 							m_matching_resource_pool[r].event_list.clear();
@@ -2149,8 +2207,16 @@ namespace ocl_patch_matching
 							match_res_out.total_cost_matrix = m_matching_resource_pool[r].sqdiff_result;
 							match_res_out.matches[0].rotation_index = rotation_index;
 						}
+						if(m_num_matches > 1ull)
+						{
+							collect_matches(candidates, m_matching_resource_pool[r].sqdiff_result, cv::Mat(), result_offset, rotation_index);
+						}
 					}
 				}
+				if(m_num_matches > 1ull)
+				{
+					write_matches(match_res_out, candidates);
+				}
 			}
 
 			inline void ocl_patch_matching::matching_policies::impl::CLMatcherImpl::compute_matches(
@@ -2176,6 +2242,7 @@ namespace ocl_patch_matching
 				match_res_out.matches.clear();
 				match_res_out.matches.push_back(Match{});
 				match_res_out.matches.back().match_cost = std::numeric_limits<double>::max();
+				std::vector<MatchCandidate> candidates;
 
 				// upload inputs
 				// input texture
@@ -2559,7 +2626,7 @@ namespace ocl_patch_matching
 					// read output and launch find min kernels
 					for(std::size_t r = 0ull; r < num_batch_rotations; ++r)
 					{
-						if(return_cost_matrix)
+						if(return_cost_matrix || m_num_matches > 1ull)
 						{
 							simple_cl::cl::Event response_finished_event{read_output_image(m_matching_resource_pool[r].sqdiff_result, m_matching_resource_pool[r].response_dims, m_matching_resource_pool[r].event_list, num_feature_batches % 2ull, m_matching_resource_pool[r])};
 							m_matching_resource_pool[r].event_list.clear();
@@ -2569,6 +2636,12 @@ namespace ocl_patch_matching
 						if(erode_texture_mask)
 						{
 							m_matching_resource_pool[r].event_list.insert(m_matching_resource_pool[r].event_list.end(), m_matching_resource_pool[r].erode_event_list.begin(), m_matching_resource_pool[r].erode_event_list.end());
+							// the eroded mask is needed on the host for extracting more than one match
+							if(m_num_matches > 1ull)
+							{
+								simple_cl::cl::Event mask_read_event{read_eroded_texture_mask_image(m_matching_resource_pool[r].texture_mask_eroded, cv::Size{texture_mask.cols, texture_mask.rows}, m_matching_resource_pool[r].erode_event_list, m_matching_resource_pool[r])};
+								m_matching_resource_pool[r].event_list.push_back(std::move(mask_read_event));
+							}
 						}
 						// launch find min kernel
 						simple_cl::cl::Event find_min_kernel_event{(*m_program_find_min)(
@@ -2601,8 +2674,16 @@ namespace ocl_patch_matching
 							match_res_out.total_cost_matrix = m_matching_resource_pool[r].sqdiff_result;
 							match_res_out.matches[0].rotation_index = rotation_index;
 						}
+						if(m_num_matches > 1ull)
+						{
+							collect_matches(candidates, m_matching_resource_pool[r].sqdiff_result, erode_texture_mask ? m_matching_resource_pool[r].texture_mask_eroded : texture_mask, result_offset, rotation_index);
+						}
 					}
 				}
+				if(m_num_matches > 1ull)
+				{
+					write_matches(match_res_out, candidates);
+				}
 			}
 
 			inline void ocl_patch_matching::matching_policies::impl::CLMatcherImpl::compute_matches(
@@ -2630,6 +2711,7 @@ namespace ocl_patch_matching
 				match_res_out.matches.clear();
 				match_res_out.matches.push_back(Match{});
 				match_res_out.matches.back().match_cost = std::numeric_limits<double>::max();
+				std::vector<MatchCandidate> candidates;
 
 				// upload inputs
 				// input texture
@@ -3053,7 +3135,7 @@ namespace ocl_patch_matching
 					// read output and launch find min kernels
 					for(std::size_t r = 0ull; r < num_batch_rotations; ++r)
 					{
-						if(return_cost_matrix)
+						if(return_cost_matrix || m_num_matches > 1ull)
 						{
 							simple_cl::cl::Event response_finished_event{read_output_image(m_matching_resource_pool[r].sqdiff_result, m_matching_resource_pool[r].response_dims, m_matching_resource_pool[r].event_list, num_feature_batches % 2ull, m_matching_resource_pool[r])};
 							m_matching_resource_pool[r].event_list.clear();
@@ -3063,6 +3145,12 @@ namespace ocl_patch_matching
 						if(erode_texture_mask)
 						{
 							m_matching_resource_pool[r].event_list.insert(m_matching_resource_pool[r].event_list.end(), m_matching_resource_pool[r].erode_event_list.begin(), m_matching_resource_pool[r].erode_event_list.end());
+							// the eroded mask is needed on the host for extracting more than one match
+							if(m_num_matches > 1ull)
+							{
+								simple_cl::cl::Event mask_read_event{read_eroded_texture_mask_image(m_matching_resource_pool[r].texture_mask_eroded, cv::Size{texture_mask.cols, texture_mask.rows}, m_matching_resource_pool[r].erode_event_list, m_matching_resource_pool[r])};
+								m_matching_resource_pool[r].event_list.push_back(std::move(mask_read_event));
+							}
 						}
 						// launch find min kernel
 						simple_cl::cl::Event find_min_kernel_event{(*m_program_find_min)(
@@ -3095,8 +3183,16 @@ namespace ocl_patch_matching
 							match_res_out.total_cost_matrix = m_matching_resource_pool[r].sqdiff_result;
 							match_res_out.matches[0].rotation_index = rotation_index;
 						}
+						if(m_num_matches > 1ull)
+						{
+							collect_matches(candidates, m_matching_resource_pool[r].sqdiff_result, erode_texture_mask ? m_matching_resource_pool[r].texture_mask_eroded : texture_mask, result_offset, rotation_index);
+						}
 					}
 				}				
+				if(m_num_matches > 1ull)
+				{
+					write_matches(match_res_out, candidates);
+				}
 			}
 
 			inline cv::Vec3i ocl_patch_matching::matching_policies::impl::CLMatcherImpl::response_dimensions(
@@ -3206,6 +3302,11 @@ void ocl_patch_matching::matching_policies::CLMatcher::compute_matches(
 	impl()->compute_matches(texture, texture_mask, kernel, kernel_mask, texture_rotations, match_res_out, erode_texture_mask, return_cost_matrix);
 }
 
+void ocl_patch_matching::matching_policies::CLMatcher::set_num_matches(std::size_t num_matches, int nms_radius)
+{
+	impl()->set_num_matches(num_matches, nms_radius);
+}
+
 cv::Vec3i ocl_patch_matching::matching_policies::CLMatcher::response_dimensions(
 	const Texture& texture,
 	const Texture& kernel,
@@ -76,7 +76,7 @@ namespace ocl_patch_matching
 
 			/**
 			 *	\brief                      Performs one matching pass given texture, kernel and a number of rotations.
-			 *	\note	This implementation only returns the best match via MatchingResult.
+			 *	\note	This implementation returns the best match via MatchingResult, or the best matches as configured by set_num_matches().
 			 *	\param texture              Input texture.
 			 *	\param kernel               Kernel or template to be searched for in texture.
 			 *	\param texture_rotations    Input texture rotations to try.
@@ -93,7 +93,7 @@ namespace ocl_patch_matching
 
 			/**
 			 *  \brief                      Performs one matching pass given texture, kernel and a number of rotations. Possible matches are masked using texture_mask.
-			 *	\note	This implementation only returns the best match via MatchingResult.
+			 *	\note	This implementation returns the best match via MatchingResult, or the best matches as configured by set_num_matches().
 			 *  texture_mask can be any grayscale image. Every pixel in the input texture with the corresponsing mask pixel > 0 is considered as a potential match candidate.
 			 *  As an optional step, the mask can be eroded with the kernel bounding box as structuring element, first.
 			 *  \param texture              Input texture.
@@ -116,7 +116,7 @@ namespace ocl_patch_matching
 
 			/**
 			 *  \brief                      Performs one matching pass given texture, kernel and a number of rotations. The kernel is masked using kernel_mask.
-			 *	\note	This implementation only returns the best match via MatchingResult.
+			 *	\note	This implementation returns the best match via MatchingResult, or the best matches as configured by set_num_matches().
 			 *  kernel_mask can be any grayscale image. Only kernel pixels whose corresponding kernel mask pixel is > 0 are considered for the calculation of matching costs.
 			 *  As an optional step, the mask can be eroded with the kernel bounding box as structuring element, first.
 			 *  \param texture              Input texture.
@@ -137,7 +137,7 @@ namespace ocl_patch_matching
 
 			/**
 			 *  \brief                      Performs one matching pass given texture, kernel and a number of rotations. Possible matches are masked using texture_mask and the kernel is masked using kernel_mask.
-			 *	\note	This implementation only returns the best match via MatchingResult.
+			 *	\note	This implementation returns the best match via MatchingResult, or the best matches as configured by set_num_matches().
 			 *  texture_mask can be any grayscale image. Every pixel in the input texture with the corresponsing mask pixel > 0 is considered as a potential match candidate.
 			 *  kernel_mask can be any grayscale image. Only kernel pixels whose corresponding kernel mask pixel is > 0 are considered for the calculation of matching costs.
 			 *  As an optional step, the mask can be eroded with the kernel bounding box as structuring element, first.
@@ -185,6 +185,16 @@ namespace ocl_patch_matching
 				double texture_rotation
 			) const override;
 
+			/**
+			 *	\brief	Sets the number of matches returned via MatchingResult::matches.
+			 *
+			 *	With more than one match, the cost matrices of all rotations are read back and the matches are extracted on the host with non-maximum suppression.
+			 *
+			 *	\param num_matches	Maximum number of matches per matching pass. Defaults to 1.
+			 *	\param nms_radius	Matches of the same rotation are at least nms_radius + 1 pixels apart (Chebyshev distance).
+			*/
+			void set_num_matches(std::size_t num_matches, int nms_radius);
+
 		private:
 			std::unique_ptr<impl::CLMatcherImpl> m_impl;					///< Pointer to implementation
 			impl::CLMatcherImpl* impl() { return m_impl.get(); }			///< Accessor for implementing const correctness
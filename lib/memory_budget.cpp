@@ -0,0 +1,62 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "memory_budget.hpp"
+
+#include <algorithm>
+
+MemoryBudget::MemoryBudget(double budget_bytes) :
+  m_budget_bytes(budget_bytes),
+  m_used_bytes(0.0),
+  m_peak_bytes(0.0)
+{
+}
+
+void MemoryBudget::acquire(double bytes)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_budget_bytes > 0.0)
+  {
+    m_released.wait(lock, [&]() { return m_used_bytes == 0.0 || m_used_bytes + bytes <= m_budget_bytes; });
+  }
+  m_used_bytes += bytes;
+  m_peak_bytes = std::max(m_peak_bytes, m_used_bytes);
+}
+
+void MemoryBudget::release(double bytes)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_used_bytes = std::max(m_used_bytes - bytes, 0.0);
+  }
+  m_released.notify_all();
+}
+
+double MemoryBudget::peak_bytes() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_peak_bytes;
+}
@@ -0,0 +1,80 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_MEMORY_BUDGET_HPP_
+#define TRLIB_MEMORY_BUDGET_HPP_
+
+#include <condition_variable>
+#include <mutex>
+
+/*
+ * Working memory shared by concurrently running tasks. acquire blocks until
+ * the requested bytes fit into the budget next to the bytes held by running
+ * tasks. A request larger than the whole budget is granted as soon as nothing
+ * else is held, so every task eventually runs. Tasks must not wait for other
+ * tasks while holding bytes. A budget <= 0 never blocks.
+ */
+class MemoryBudget
+{
+public:
+  explicit MemoryBudget(double budget_bytes);
+
+  void acquire(double bytes);
+  void release(double bytes);
+
+  double peak_bytes() const;
+
+  /*
+   * Holds bytes for the lifetime of the scope.
+   */
+  class Reservation
+  {
+  public:
+    Reservation(MemoryBudget& budget, double bytes) :
+      m_budget(budget),
+      m_bytes(bytes)
+    {
+      m_budget.acquire(m_bytes);
+    }
+
+    ~Reservation()
+    {
+      m_budget.release(m_bytes);
+    }
+
+    Reservation(const Reservation&) = delete;
+    Reservation& operator=(const Reservation&) = delete;
+
+  private:
+    MemoryBudget& m_budget;
+    double m_bytes;
+  };
+
+private:
+  double m_budget_bytes;
+  double m_used_bytes;
+  double m_peak_bytes;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_released;
+};
+
+#endif /* TRLIB_MEMORY_BUDGET_HPP_ */
@@ -343,7 +343,7 @@ namespace ocl_patch_matching
         template <typename ConcretePolicy>
         ConcretePolicy& get_policy()
         {
-            return &dynamic_cast<ConcretePolicy*>(m_matching_policy.get());
+            return *dynamic_cast<ConcretePolicy*>(m_matching_policy.get());
         }
 
         /**
@@ -354,7 +354,7 @@ namespace ocl_patch_matching
         template <typename ConcretePolicy>
         const ConcretePolicy& get_policy() const
         {
-            return &dynamic_cast<const ConcretePolicy*>(m_matching_policy.get());
+            return *dynamic_cast<const ConcretePolicy*>(m_matching_policy.get());
         }
 
     private:
@@ -0,0 +1,230 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "placement_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "affine_transformation.hpp"
+
+PlacementIndex::PlacementIndex(int cell_size, int margin) :
+  m_cell_size(std::max(cell_size, 1)),
+  m_margin(std::max(margin, 0))
+{
+}
+
+void PlacementIndex::insert(const Patch& patch, cv::Size size)
+{
+  const PatchKey key = patch_key(patch, size);
+  if (m_ids.count(key))
+  {
+    return;
+  }
+
+  const cv::Rect2d rect(patch.anchor_source.x - m_margin, patch.anchor_source.y - m_margin, size.width + 2 * m_margin, size.height + 2 * m_margin);
+  const Quad quad = transform_quad(patch.transformation_source_inv, rect);
+
+  int id;
+  if (m_free.empty())
+  {
+    id = static_cast<int>(m_entries.size());
+    m_entries.push_back(Entry{patch.source_index, quad, cell_range(quad)});
+  }
+  else
+  {
+    id = m_free.back();
+    m_free.pop_back();
+    m_entries[id] = Entry{patch.source_index, quad, cell_range(quad)};
+  }
+  m_ids[key] = id;
+
+  const Entry& entry = m_entries[id];
+  for (int y = entry.cells.y; y < entry.cells.y + entry.cells.height; ++y)
+  {
+    for (int x = entry.cells.x; x < entry.cells.x + entry.cells.width; ++x)
+    {
+      m_cells[CellKey(entry.texture_index, x, y)].push_back(id);
+    }
+  }
+}
+
+void PlacementIndex::erase(const Patch& patch, cv::Size size)
+{
+  auto it_id = m_ids.find(patch_key(patch, size));
+  if (it_id == m_ids.end())
+  {
+    return;
+  }
+
+  const int id = it_id->second;
+  const Entry& entry = m_entries[id];
+  for (int y = entry.cells.y; y < entry.cells.y + entry.cells.height; ++y)
+  {
+    for (int x = entry.cells.x; x < entry.cells.x + entry.cells.width; ++x)
+    {
+      auto it_cell = m_cells.find(CellKey(entry.texture_index, x, y));
+      if (it_cell == m_cells.end())
+      {
+        continue;
+      }
+      std::vector<int>& ids = it_cell->second;
+      ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+      if (ids.empty())
+      {
+        m_cells.erase(it_cell);
+      }
+    }
+  }
+
+  m_ids.erase(it_id);
+  m_free.push_back(id);
+}
+
+bool PlacementIndex::intersects(int texture_index, const cv::Mat& transformation_matrix, cv::Rect rect) const
+{
+  if (m_ids.empty())
+  {
+    return false;
+  }
+
+  cv::Mat transformation_matrix_inv;
+  cv::invertAffineTransform(transformation_matrix, transformation_matrix_inv);
+  const Quad quad = transform_quad(transformation_matrix_inv, cv::Rect2d(rect.x, rect.y, rect.width, rect.height));
+  const cv::Rect cells = cell_range(quad);
+  for (int y = cells.y; y < cells.y + cells.height; ++y)
+  {
+    for (int x = cells.x; x < cells.x + cells.width; ++x)
+    {
+      auto it_cell = m_cells.find(CellKey(texture_index, x, y));
+      if (it_cell == m_cells.end())
+      {
+        continue;
+      }
+      for (int id : it_cell->second)
+      {
+        if (quads_intersect(quad, m_entries[id].quad))
+        {
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+std::vector<std::vector<cv::Point2f>> PlacementIndex::polygons(int texture_index, const cv::Mat& transformation_matrix) const
+{
+  std::vector<std::vector<cv::Point2f>> result;
+  for (const auto& id : m_ids)
+  {
+    const Entry& entry = m_entries[id.second];
+    if (entry.texture_index != texture_index)
+    {
+      continue;
+    }
+
+    std::vector<cv::Point2f> polygon;
+    for (const cv::Point2d& p : entry.quad)
+    {
+      polygon.push_back(AffineTransformation::transform<double, float>(transformation_matrix, p));
+    }
+    result.push_back(polygon);
+  }
+  return result;
+}
+
+PlacementIndex::PatchKey PlacementIndex::patch_key(const Patch& patch, cv::Size size)
+{
+  return PatchKey(patch.source_index, patch.source_rot, patch.anchor_source.x, patch.anchor_source.y, size.width, size.height);
+}
+
+PlacementIndex::Quad PlacementIndex::transform_quad(const cv::Mat& transformation_matrix, cv::Rect2d rect)
+{
+  const Quad corners = {
+    cv::Point2d(rect.x, rect.y),
+    cv::Point2d(rect.x + rect.width, rect.y),
+    cv::Point2d(rect.x + rect.width, rect.y + rect.height),
+    cv::Point2d(rect.x, rect.y + rect.height)};
+
+  Quad quad;
+  for (size_t i = 0; i < corners.size(); ++i)
+  {
+    quad[i] = AffineTransformation::transform(transformation_matrix, corners[i]);
+  }
+  return quad;
+}
+
+bool PlacementIndex::quads_intersect(const Quad& lhs, const Quad& rhs)
+{
+  // Separating axis test over the edge normals of both quads; touching quads count as intersecting.
+  for (const Quad* quad : {&lhs, &rhs})
+  {
+    for (size_t i = 0; i < quad->size(); ++i)
+    {
+      const cv::Point2d edge = (*quad)[(i + 1) % quad->size()] - (*quad)[i];
+      const cv::Point2d normal(-edge.y, edge.x);
+
+      double min_lhs = std::numeric_limits<double>::max(), max_lhs = -std::numeric_limits<double>::max();
+      double min_rhs = std::numeric_limits<double>::max(), max_rhs = -std::numeric_limits<double>::max();
+      for (size_t j = 0; j < lhs.size(); ++j)
+      {
+        const double p_lhs = normal.dot(lhs[j]);
+        const double p_rhs = normal.dot(rhs[j]);
+        min_lhs = std::min(min_lhs, p_lhs);
+        max_lhs = std::max(max_lhs, p_lhs);
+        min_rhs = std::min(min_rhs, p_rhs);
+        max_rhs = std::max(max_rhs, p_rhs);
+      }
+
+      if (max_lhs < min_rhs || max_rhs < min_lhs)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+cv::Rect PlacementIndex::cell_range(const Quad& quad) const
+{
+  double x_min = quad[0].x, x_max = quad[0].x, y_min = quad[0].y, y_max = quad[0].y;
+  for (const cv::Point2d& p : quad)
+  {
+    x_min = std::min(x_min, p.x);
+    x_max = std::max(x_max, p.x);
+    y_min = std::min(y_min, p.y);
+    y_max = std::max(y_max, p.y);
+  }
+
+  const int x0 = static_cast<int>(std::floor(x_min / m_cell_size));
+  const int y0 = static_cast<int>(std::floor(y_min / m_cell_size));
+  const int x1 = static_cast<int>(std::floor(x_max / m_cell_size));
+  const int y1 = static_cast<int>(std::floor(y_max / m_cell_size));
+  return cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
@@ -0,0 +1,102 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_PLACEMENT_INDEX_HPP_
+#define TRLIB_PLACEMENT_INDEX_HPP_
+
+#include <array>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "patch.hpp"
+
+/*
+ * Uniform grid of the source areas of placed patches, per texture. Areas are
+ * stored as quads in the frame of the unrotated texture, so they can be
+ * queried from any rotation frame. Each quad is the source rectangle of a
+ * patch grown by margin pixels, which covers the erosion and resampling of
+ * Texture::update_mask_done. Masks are not stored, so a reported overlap has
+ * to be confirmed on the texture mask, while no overlap means that no placed
+ * material is touched.
+ */
+class PlacementIndex
+{
+public:
+  PlacementIndex(int cell_size = 64, int margin = 3);
+
+  void insert(const Patch& patch, cv::Size size);
+  void erase(const Patch& patch, cv::Size size);
+
+  /*
+   * Whether rect in the rotation frame given by transformation_matrix
+   * (unrotated to rotated coordinates) overlaps a placed source area.
+   */
+  bool intersects(int texture_index, const cv::Mat& transformation_matrix, cv::Rect rect) const;
+
+  /*
+   * Placed source areas of a texture as polygons in the given rotation frame.
+   */
+  std::vector<std::vector<cv::Point2f>> polygons(int texture_index, const cv::Mat& transformation_matrix) const;
+
+  void clear()
+  {
+    m_entries.clear();
+    m_free.clear();
+    m_ids.clear();
+    m_cells.clear();
+  }
+
+  size_t size() const
+  {
+    return m_ids.size();
+  }
+
+private:
+  typedef std::array<cv::Point2d, 4> Quad;
+  typedef std::tuple<int, int, int, int, int, int> PatchKey;
+  typedef std::tuple<int, int, int> CellKey;
+
+  struct Entry
+  {
+    int texture_index;
+    Quad quad;
+    cv::Rect cells;
+  };
+
+  static PatchKey patch_key(const Patch& patch, cv::Size size);
+  static Quad transform_quad(const cv::Mat& transformation_matrix, cv::Rect2d rect);
+  static bool quads_intersect(const Quad& lhs, const Quad& rhs);
+
+  cv::Rect cell_range(const Quad& quad) const;
+
+  int m_cell_size;
+  int m_margin;
+  std::vector<Entry> m_entries;
+  std::vector<int> m_free;
+  std::map<PatchKey, int> m_ids;
+  std::map<CellKey, std::vector<int>> m_cells;
+};
+
+#endif /* TRLIB_PLACEMENT_INDEX_HPP_ */
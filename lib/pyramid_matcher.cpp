@@ -0,0 +1,261 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "pyramid_matcher.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+PyramidMatcher::PyramidMatcher(int num_levels, int num_candidates, int refine_radius, bool exact) :
+  m_num_levels(std::max(num_levels, 1)),
+  m_num_candidates(std::max(num_candidates, 1)),
+  m_refine_radius(std::max(refine_radius, 1)),
+  m_exact(exact)
+{}
+
+std::vector<FeatureVector> PyramidMatcher::build_pyramid(const FeatureVector& features, int num_levels)
+{
+  std::vector<FeatureVector> pyramid;
+  pyramid.push_back(features);
+
+  for (int l = 1; l < num_levels; ++l)
+  {
+    const FeatureVector& prev = pyramid.back();
+    if (prev.rows() < 2 || prev.cols() < 2)
+    {
+      break;
+    }
+
+    FeatureVector level;
+    for (int i = 0; i < prev.num_channels(); ++i)
+    {
+      cv::Mat channel;
+      cv::pyrDown(prev.channel_float(i), channel);
+      level.feature_vector_float.push_back(channel);
+    }
+    pyramid.push_back(level);
+  }
+
+  return pyramid;
+}
+
+/*
+ * A coarse position is valid if any level 0 position it covers is valid.
+ */
+static cv::Mat downsample_valid(cv::Mat valid_integral, cv::Size size_out, int factor)
+{
+  const int rows_0 = valid_integral.rows - 1;
+  const int cols_0 = valid_integral.cols - 1;
+
+  cv::Mat valid = cv::Mat::zeros(size_out, CV_8UC1);
+  for (int y = 0; y < size_out.height && y * factor < rows_0; ++y)
+  {
+    const int y0 = y * factor;
+    const int y1 = std::min(y0 + factor, rows_0);
+    unsigned char* valid_row = valid.ptr<unsigned char>(y);
+
+    for (int x = 0; x < size_out.width && x * factor < cols_0; ++x)
+    {
+      const int x0 = x * factor;
+      const int x1 = std::min(x0 + factor, cols_0);
+      const int sum = valid_integral.at<int>(y1, x1) - valid_integral.at<int>(y0, x1) - valid_integral.at<int>(y1, x0) + valid_integral.at<int>(y0, x0);
+      valid_row[x] = sum > 0 ? 255 : 0;
+    }
+  }
+  return valid;
+}
+
+/*
+ * Best positions of a cost map in ascending order of cost. Positions next to
+ * an already selected one are suppressed, so the refinement windows spread.
+ */
+static std::vector<cv::Point> select_candidates(cv::Mat cost, int num_candidates)
+{
+  std::vector<std::pair<float, cv::Point>> entries;
+  for (int y = 0; y < cost.rows; ++y)
+  {
+    const float* cost_row = cost.ptr<float>(y);
+    for (int x = 0; x < cost.cols; ++x)
+    {
+      if (cost_row[x] < FLT_MAX)
+      {
+        entries.emplace_back(cost_row[x], cv::Point(x, y));
+      }
+    }
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const std::pair<float, cv::Point>& lhs, const std::pair<float, cv::Point>& rhs) { return lhs.first < rhs.first; });
+
+  std::vector<cv::Point> candidates;
+  for (const auto& entry : entries)
+  {
+    if (static_cast<int>(candidates.size()) >= num_candidates)
+    {
+      break;
+    }
+
+    const bool suppressed = std::any_of(candidates.begin(), candidates.end(), [&entry](cv::Point p)
+    {
+      return std::abs(p.x - entry.second.x) <= 1 && std::abs(p.y - entry.second.y) <= 1;
+    });
+
+    if (!suppressed)
+    {
+      candidates.push_back(entry.second);
+    }
+  }
+
+  return candidates;
+}
+
+static PyramidMatcher::Result match_exhaustive(const FeatureVector& texture, const FeatureVector& kernel, cv::Mat kernel_mask, cv::Mat valid)
+{
+  PyramidMatcher::Result result{std::numeric_limits<double>::max(), cv::Point(-1, -1)};
+  if (cv::countNonZero(valid) == 0)
+  {
+    return result;
+  }
+
+  const cv::Mat cost = sqdiff_masked(texture, kernel, RowRunMask(kernel_mask), valid);
+  cv::minMaxLoc(cost, &result.cost, 0, &result.pos, 0, valid);
+  return result;
+}
+
+PyramidMatcher::Result PyramidMatcher::match(const std::vector<FeatureVector>& texture_pyramid, const FeatureVector& kernel, cv::Mat kernel_mask, cv::Mat valid, MatchingStatistics* stats) const
+{
+  if (!enabled())
+  {
+    return match_exhaustive(texture_pyramid.front(), kernel, kernel_mask, valid);
+  }
+
+  const Result result = match_pyramid(texture_pyramid, kernel, kernel_mask, valid);
+  if (!m_exact)
+  {
+    if (stats)
+    {
+      ++stats->num_pyramid_searches;
+    }
+    return result;
+  }
+
+  const Result result_exact = match_exhaustive(texture_pyramid.front(), kernel, kernel_mask, valid);
+  if (stats)
+  {
+    ++stats->num_pyramid_searches;
+    if (result.cost > result_exact.cost)
+    {
+      ++stats->num_pyramid_misses;
+    }
+  }
+  return result_exact;
+}
+
+PyramidMatcher::Result PyramidMatcher::match_pyramid(const std::vector<FeatureVector>& texture_pyramid, const FeatureVector& kernel, cv::Mat kernel_mask, cv::Mat valid) const
+{
+  const std::vector<FeatureVector> kernel_pyramid = build_pyramid(kernel, std::min(m_num_levels, static_cast<int>(texture_pyramid.size())));
+
+  std::vector<cv::Mat> kernel_masks(1, kernel_mask);
+  std::vector<RowRunMask> kernel_runs(1, RowRunMask(kernel_mask));
+
+  // Only use levels where the kernel keeps some structure and still fits into the texture.
+  int num_levels = 1;
+  for (int l = 1; l < static_cast<int>(kernel_pyramid.size()); ++l)
+  {
+    const cv::Size kernel_size = kernel_pyramid[l].size();
+    if (kernel_size.width < 4 || kernel_size.height < 4 ||
+        kernel_size.width > texture_pyramid[l].cols() || kernel_size.height > texture_pyramid[l].rows())
+    {
+      break;
+    }
+
+    cv::Mat mask;
+    cv::resize(kernel_masks.back(), mask, kernel_size, 0.0, 0.0, cv::INTER_AREA);
+    mask = mask > 127;
+    if (cv::countNonZero(mask) == 0)
+    {
+      break;
+    }
+
+    kernel_masks.push_back(mask);
+    kernel_runs.emplace_back(mask);
+    ++num_levels;
+  }
+
+  if (num_levels == 1)
+  {
+    return match_exhaustive(texture_pyramid.front(), kernel, kernel_mask, valid);
+  }
+
+  cv::Mat valid_integral;
+  cv::integral(valid != 0, valid_integral, CV_32S);
+
+  auto valid_at_level = [&](int l)
+  {
+    const cv::Size size_out(texture_pyramid[l].cols() - kernel_pyramid[l].cols() + 1, texture_pyramid[l].rows() - kernel_pyramid[l].rows() + 1);
+    return l == 0 ? valid : downsample_valid(valid_integral, size_out, 1 << l);
+  };
+
+  // Exhaustive search at the coarsest level.
+  const int level_coarse = num_levels - 1;
+  cv::Mat cost = sqdiff_masked(texture_pyramid[level_coarse], kernel_pyramid[level_coarse], kernel_runs[level_coarse], valid_at_level(level_coarse));
+  std::vector<cv::Point> candidates = select_candidates(cost, m_num_candidates);
+
+  // Refine candidates in small windows at each finer level.
+  for (int l = level_coarse - 1; l >= 0 && !candidates.empty(); --l)
+  {
+    const cv::Mat valid_level = valid_at_level(l);
+    const cv::Rect area(cv::Point(0, 0), valid_level.size());
+    const cv::Size kernel_size = kernel_pyramid[l].size();
+
+    cost = cv::Mat(valid_level.size(), CV_32FC1, cv::Scalar(FLT_MAX));
+    for (cv::Point p : candidates)
+    {
+      const cv::Rect window = cv::Rect(2 * p.x - m_refine_radius, 2 * p.y - m_refine_radius, 2 * m_refine_radius + 1, 2 * m_refine_radius + 1) & area;
+      if (window.area() == 0 || cv::countNonZero(valid_level(window)) == 0)
+      {
+        continue;
+      }
+
+      const cv::Rect texture_window(window.tl(), window.size() + kernel_size - cv::Size(1, 1));
+      const cv::Mat cost_window = sqdiff_masked(texture_pyramid[l](texture_window), kernel_pyramid[l], kernel_runs[l], valid_level(window));
+
+      cv::Mat cost_roi = cost(window);
+      cv::min(cost_roi, cost_window, cost_roi);
+    }
+
+    candidates = select_candidates(cost, l == 0 ? 1 : m_num_candidates);
+  }
+
+  if (candidates.empty())
+  {
+    return Result{std::numeric_limits<double>::max(), cv::Point(-1, -1)};
+  }
+
+  return Result{cost.at<float>(candidates.front()), candidates.front()};
+}
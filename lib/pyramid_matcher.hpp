@@ -0,0 +1,87 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_PYRAMID_MATCHER_HPP_
+#define TRLIB_PYRAMID_MATCHER_HPP_
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "feature_vector.hpp"
+#include "sqdiff_kernels.hpp"
+
+/*
+ * Coarse-to-fine SQDIFF matching for large kernels.
+ *
+ * The texture feature stack is reduced to a Gaussian pyramid once. A match
+ * searches exhaustively at the coarsest level, keeps the best num_candidates
+ * positions and refines them in windows of +-refine_radius pixels around the
+ * corresponding position at each finer level. The returned cost is the exact
+ * SQDIFF at level 0.
+ */
+class PyramidMatcher
+{
+public:
+  struct Result
+  {
+    double cost;
+    cv::Point pos;
+  };
+
+  PyramidMatcher(int num_levels = 1, int num_candidates = 8, int refine_radius = 2, bool exact = false);
+
+  bool enabled() const
+  {
+    return m_num_levels > 1;
+  }
+
+  int num_levels() const
+  {
+    return m_num_levels;
+  }
+
+  /*
+   * Pyramid of a feature stack. Level 0 shares the data of features, coarser
+   * levels only hold float channels.
+   */
+  static std::vector<FeatureVector> build_pyramid(const FeatureVector& features, int num_levels);
+
+  /*
+   * Finds the minimum SQDIFF of kernel (masked by kernel_mask) over the texture
+   * pyramid at positions where valid (CV_8UC1, size of the level 0 result) is
+   * nonzero. With exact set, level 0 is searched exhaustively instead and
+   * stats->num_pyramid_misses counts how often the pyramid search would have
+   * returned a worse match.
+   */
+  Result match(const std::vector<FeatureVector>& texture_pyramid, const FeatureVector& kernel, cv::Mat kernel_mask, cv::Mat valid, MatchingStatistics* stats = nullptr) const;
+
+private:
+  Result match_pyramid(const std::vector<FeatureVector>& texture_pyramid, const FeatureVector& kernel, cv::Mat kernel_mask, cv::Mat valid) const;
+
+  int m_num_levels;
+  int m_num_candidates;
+  int m_refine_radius;
+  bool m_exact;
+};
+
+#endif /* TRLIB_PYRAMID_MATCHER_HPP_ */
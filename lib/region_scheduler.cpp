@@ -0,0 +1,85 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "region_scheduler.hpp"
+
+#include <utility>
+
+const std::vector<MatchCandidate>* RegionScheduler::find(const PatchRegion& region) const
+{
+  auto it = m_matches.find(region_key(region));
+  return it == m_matches.end() ? nullptr : &it->second.candidates;
+}
+
+void RegionScheduler::store(const PatchRegion& region, std::vector<MatchCandidate> candidates)
+{
+  m_matches[region_key(region)] = Entry{std::move(candidates), m_generation};
+}
+
+void RegionScheduler::erase(const PatchRegion& region)
+{
+  m_matches.erase(region_key(region));
+}
+
+void RegionScheduler::consume(const Patch& patch)
+{
+  ++m_generation;
+  // A patch may be masked more than once; the first placement counts.
+  m_consumed.emplace(patch_key(patch), m_generation);
+}
+
+int RegionScheduler::release(const Patch& patch)
+{
+  // Without a known placement, any stored match may have seen the material as consumed.
+  uint64_t generation_consumed = 0;
+  auto it_consumed = m_consumed.find(patch_key(patch));
+  if (it_consumed != m_consumed.end())
+  {
+    generation_consumed = it_consumed->second;
+    m_consumed.erase(it_consumed);
+  }
+  ++m_generation;
+
+  int num_dropped = 0;
+  for (auto it = m_matches.begin(); it != m_matches.end();)
+  {
+    if (it->second.generation >= generation_consumed)
+    {
+      it = m_matches.erase(it);
+      ++num_dropped;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  return num_dropped;
+}
+
+RegionScheduler::PatchKey RegionScheduler::patch_key(const Patch& patch)
+{
+  return PatchKey(patch.source_index, patch.source_rot, patch.anchor_source.x, patch.anchor_source.y, patch.size().width, patch.size().height);
+}
@@ -0,0 +1,86 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_REGION_SCHEDULER_HPP_
+#define TRLIB_REGION_SCHEDULER_HPP_
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "match_candidates.hpp"
+#include "patch.hpp"
+#include "patch_region.hpp"
+
+/*
+ * Best match candidates of queued regions, searched ahead of their turn, best
+ * first. Greedy placement only consumes texture material, so the first
+ * candidate is still the exact search result when the region comes up as long
+ * as its source window is available; the others stand in for a rematch when
+ * it is not. The exception is material that was consumed when the candidates
+ * were searched and has been released since: every placement and release
+ * advances a generation counter, and releasing a patch drops all candidates
+ * searched while that patch was placed.
+ */
+class RegionScheduler
+{
+public:
+  const std::vector<MatchCandidate>* find(const PatchRegion& region) const;
+  void store(const PatchRegion& region, std::vector<MatchCandidate> candidates);
+  void erase(const PatchRegion& region);
+
+  void consume(const Patch& patch);
+
+  /*
+   * Returns the number of matches dropped.
+   */
+  int release(const Patch& patch);
+
+  void clear()
+  {
+    m_matches.clear();
+    m_consumed.clear();
+  }
+
+  size_t size() const
+  {
+    return m_matches.size();
+  }
+
+private:
+  struct Entry
+  {
+    std::vector<MatchCandidate> candidates;
+    uint64_t generation;
+  };
+
+  typedef std::tuple<int, int, int, int, int, int> PatchKey;
+
+  static PatchKey patch_key(const Patch& patch);
+
+  std::map<RegionKey, Entry> m_matches;
+  std::map<PatchKey, uint64_t> m_consumed;
+  uint64_t m_generation = 0;
+};
+
+#endif /* TRLIB_REGION_SCHEDULER_HPP_ */
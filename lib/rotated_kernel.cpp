@@ -0,0 +1,157 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rotated_kernel.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "feature_evaluator.hpp"
+
+static cv::Matx22d rotation_part(const cv::Mat& transformation_matrix)
+{
+  return cv::Matx22d(
+    transformation_matrix.at<double>(0, 0), transformation_matrix.at<double>(0, 1),
+    transformation_matrix.at<double>(1, 0), transformation_matrix.at<double>(1, 1));
+}
+
+// Angle as used by FeatureEvaluator::rotate_response.
+static double rotation_angle(const cv::Mat& transformation_matrix)
+{
+  return std::atan2(transformation_matrix.at<double>(0, 1), transformation_matrix.at<double>(0, 0));
+}
+
+RotatedKernel::RotatedKernel(const FeatureVector& kernel, cv::Mat kernel_mask, const cv::Mat& transformation_matrix, MatchingPrecision precision, int num_frequencies, int num_directions) :
+  m_kernel_size(kernel.size()),
+  m_cost_scale(1.0)
+{
+  if (kernel_mask.empty())
+  {
+    kernel_mask = cv::Mat(kernel.size(), CV_8UC1, cv::Scalar(1));
+  }
+
+  /*
+   * Kernel pixel q lands at rotation_inv * q - offset, where offset is the
+   * top left corner of the bounding box of all rotated pixel centers.
+   */
+  const cv::Matx22d rotation_inv = rotation_part(transformation_matrix).t();
+  cv::Point2d p_min(DBL_MAX, DBL_MAX);
+  cv::Point2d p_max(-DBL_MAX, -DBL_MAX);
+  for (int y : {0, m_kernel_size.height - 1})
+  {
+    for (int x : {0, m_kernel_size.width - 1})
+    {
+      const cv::Vec2d p = rotation_inv * cv::Vec2d(x, y);
+      p_min = cv::Point2d(std::min(p_min.x, p[0]), std::min(p_min.y, p[1]));
+      p_max = cv::Point2d(std::max(p_max.x, p[0]), std::max(p_max.y, p[1]));
+    }
+  }
+
+  m_offset = cv::Point(static_cast<int>(std::floor(p_min.x + 1e-6)), static_cast<int>(std::floor(p_min.y + 1e-6)));
+  const cv::Size size(
+    static_cast<int>(std::ceil(p_max.x - 1e-6)) - m_offset.x + 1,
+    static_cast<int>(std::ceil(p_max.y - 1e-6)) - m_offset.y + 1);
+
+  const cv::Mat warp_matrix = (cv::Mat_<double>(2, 3) <<
+    rotation_inv(0, 0), rotation_inv(0, 1), -m_offset.x,
+    rotation_inv(1, 0), rotation_inv(1, 1), -m_offset.y);
+
+  std::vector<cv::Mat> channels(kernel.num_channels());
+  for (int i = 0; i < kernel.num_channels(); ++i)
+  {
+    cv::warpAffine(kernel[i], channels[i], warp_matrix, size, cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(0));
+  }
+
+  // Direction theta of the rotated texture is direction theta + angle of the unrotated one, so the kernel's directions move back by angle.
+  m_response = rotate_orientations(FeatureVector(channels), -rotation_angle(transformation_matrix), num_frequencies, num_directions);
+  if (precision == MatchingPrecision::Float32)
+  {
+    m_response.compute_float_store();
+  }
+
+  cv::Mat mask_binary = cv::Mat::zeros(kernel_mask.size(), CV_8UC1);
+  mask_binary.setTo(1, kernel_mask != 0);
+  cv::warpAffine(mask_binary, m_mask, warp_matrix, size, cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(0));
+  m_runs = RowRunMask(m_mask);
+
+  m_cost_scale = static_cast<double>(cv::countNonZero(mask_binary)) / std::max(m_runs.num_pixels(), 1);
+}
+
+cv::Point RotatedKernel::rotated_anchor(cv::Point pos, const cv::Mat& transformation_matrix, cv::Size rotated_size) const
+{
+  const cv::Matx22d rotation = rotation_part(transformation_matrix);
+  const cv::Vec2d p = rotation * cv::Vec2d(pos.x - m_offset.x, pos.y - m_offset.y) +
+    cv::Vec2d(transformation_matrix.at<double>(0, 2), transformation_matrix.at<double>(1, 2));
+
+  return cv::Point(
+    std::min(std::max(cvRound(p[0]), 0), std::max(rotated_size.width - m_kernel_size.width, 0)),
+    std::min(std::max(cvRound(p[1]), 0), std::max(rotated_size.height - m_kernel_size.height, 0)));
+}
+
+FeatureVector rotated_response_window(const FeatureVector& response, const cv::Mat& transformation_matrix, cv::Rect window, int num_frequencies, int num_directions)
+{
+  cv::Mat transformation_matrix_inv;
+  cv::invertAffineTransform(transformation_matrix, transformation_matrix_inv);
+
+  // Part of the unrotated feature stack covered by the window, with a margin for interpolation.
+  std::vector<cv::Point2f> corners = {
+    cv::Point2f(static_cast<float>(window.x), static_cast<float>(window.y)),
+    cv::Point2f(static_cast<float>(window.br().x), static_cast<float>(window.y)),
+    cv::Point2f(static_cast<float>(window.x), static_cast<float>(window.br().y)),
+    cv::Point2f(static_cast<float>(window.br().x), static_cast<float>(window.br().y))
+  };
+  cv::transform(corners, corners, transformation_matrix_inv);
+  cv::Rect source = cv::boundingRect(corners);
+  source = cv::Rect(source.x - 2, source.y - 2, source.width + 4, source.height + 4) & cv::Rect(cv::Point(0, 0), response.size());
+
+  std::vector<cv::Mat> channels(response.num_channels());
+  if (source.area() == 0)
+  {
+    for (cv::Mat& channel : channels)
+    {
+      channel = cv::Mat::zeros(window.size(), CV_16UC1);
+    }
+    return FeatureVector(channels);
+  }
+
+  // Maps coordinates in source to coordinates in window.
+  const cv::Matx22d rotation = rotation_part(transformation_matrix);
+  const cv::Vec2d translation = rotation * cv::Vec2d(source.x, source.y) +
+    cv::Vec2d(transformation_matrix.at<double>(0, 2) - window.x, transformation_matrix.at<double>(1, 2) - window.y);
+  const cv::Mat warp_matrix = (cv::Mat_<double>(2, 3) <<
+    rotation(0, 0), rotation(0, 1), translation[0],
+    rotation(1, 0), rotation(1, 1), translation[1]);
+
+  const FeatureVector response_source = rotate_orientations(response(source), rotation_angle(transformation_matrix), num_frequencies, num_directions);
+  for (int i = 0; i < response.num_channels(); ++i)
+  {
+    cv::warpAffine(response_source[i], channels[i], warp_matrix, window.size(), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(0));
+  }
+
+  return FeatureVector(channels);
+}
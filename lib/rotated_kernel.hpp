@@ -0,0 +1,98 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_ROTATED_KERNEL_HPP_
+#define TRLIB_ROTATED_KERNEL_HPP_
+
+#include <opencv2/opencv.hpp>
+
+#include "feature_vector.hpp"
+#include "sqdiff_kernels.hpp"
+
+/*
+ * Target kernel (features and mask) rotated into the frame of an unrotated
+ * texture. Matching it against the unrotated feature stack replaces matching
+ * the kernel against a rotated copy of the texture, so only one feature stack
+ * per texture is needed. transformation_matrix is the matrix of the rotated
+ * texture copy (unrotated to rotated coordinates). The Gabor orientation
+ * channels (num_frequencies blocks of num_directions at the end of the stack,
+ * see rotate_orientations) are shifted back by the rotation angle, the inverse
+ * of FeatureEvaluator::rotate_response. Results agree with matching the
+ * rotated texture up to resampling of the kernel and, for angles that are no
+ * multiple of the direction spacing, the blending of the orientations. For
+ * Float32 precision the float store of the rotated features is computed right
+ * away.
+ */
+class RotatedKernel
+{
+public:
+  RotatedKernel(const FeatureVector& kernel, cv::Mat kernel_mask, const cv::Mat& transformation_matrix, MatchingPrecision precision, int num_frequencies = 0, int num_directions = 0);
+
+  const FeatureVector& response() const
+  {
+    return m_response;
+  }
+
+  cv::Mat mask() const
+  {
+    return m_mask;
+  }
+
+  const RowRunMask& runs() const
+  {
+    return m_runs;
+  }
+
+  /*
+   * Resampling changes the number of active mask pixels slightly. Costs are
+   * multiplied with this factor to refer to the unrotated kernel mask again, so
+   * that costs of different rotations stay comparable.
+   */
+  double cost_scale() const
+  {
+    return m_cost_scale;
+  }
+
+  /*
+   * Anchor of the unrotated kernel in the rotated texture copy for a match at
+   * pos in the unrotated texture, clamped to rotated_size.
+   */
+  cv::Point rotated_anchor(cv::Point pos, const cv::Mat& transformation_matrix, cv::Size rotated_size) const;
+
+private:
+  FeatureVector m_response;
+  cv::Mat m_mask;
+  RowRunMask m_runs;
+  cv::Size m_kernel_size;
+  cv::Point m_offset;
+  double m_cost_scale;
+};
+
+/*
+ * Features of the rotated texture copy with the given transformation matrix
+ * inside window, resampled from the unrotated feature stack, with the Gabor
+ * orientation channels shifted like FeatureEvaluator::rotate_response does.
+ * Only the part of the feature stack covered by the window is converted.
+ */
+FeatureVector rotated_response_window(const FeatureVector& response, const cv::Mat& transformation_matrix, cv::Rect window, int num_frequencies = 0, int num_directions = 0);
+
+#endif /* TRLIB_ROTATED_KERNEL_HPP_ */
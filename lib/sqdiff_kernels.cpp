@@ -0,0 +1,488 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sqdiff_kernels.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <stdexcept>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+RowRunMask::RowRunMask(cv::Mat mask) :
+  m_size(mask.size())
+{
+  if (mask.type() != CV_8UC1)
+  {
+    throw(std::invalid_argument("RowRunMask: mask has to be of type CV_8UC1."));
+  }
+
+  for (int y = 0; y < mask.rows; ++y)
+  {
+    const unsigned char* mask_row = mask.ptr<unsigned char>(y);
+    int x = 0;
+    while (x < mask.cols)
+    {
+      if (mask_row[x] == 0)
+      {
+        ++x;
+        continue;
+      }
+
+      const int col = x;
+      while (x < mask.cols && mask_row[x] != 0)
+      {
+        ++x;
+      }
+      m_runs.push_back(Run{y, col, x - col});
+      m_num_pixels += x - col;
+    }
+  }
+}
+
+FeatureIntegral::FeatureIntegral(const FeatureVector& features) :
+  integrals(features.num_channels())
+{
+  for (int i = 0; i < features.num_channels(); ++i)
+  {
+    cv::integral(features.channel_float(i), integrals[i], CV_64F);
+  }
+}
+
+MatchingStatistics& MatchingStatistics::operator+=(const MatchingStatistics& rhs)
+{
+  num_positions += rhs.num_positions;
+  num_pruned += rhs.num_pruned;
+  num_terminated += rhs.num_terminated;
+  num_pyramid_searches += rhs.num_pyramid_searches;
+  num_pyramid_misses += rhs.num_pyramid_misses;
+  num_cached_candidates += rhs.num_cached_candidates;
+  num_validity_reused += rhs.num_validity_reused;
+  num_validity_computed += rhs.num_validity_computed;
+  num_scheduled_searches += rhs.num_scheduled_searches;
+  num_scheduled_hits += rhs.num_scheduled_hits;
+  num_scheduled_invalidations += rhs.num_scheduled_invalidations;
+  num_fine_searches += rhs.num_fine_searches;
+  num_fine_rematches += rhs.num_fine_rematches;
+  num_local_matches += rhs.num_local_matches;
+  num_local_fallbacks += rhs.num_local_fallbacks;
+  return *this;
+}
+
+bool MatchingStatistics::empty() const
+{
+  return num_positions == 0 && num_pruned == 0 && num_terminated == 0 &&
+    num_pyramid_searches == 0 && num_pyramid_misses == 0 && num_cached_candidates == 0 &&
+    num_validity_reused == 0 && num_validity_computed == 0 &&
+    num_scheduled_searches == 0 && num_scheduled_hits == 0 && num_scheduled_invalidations == 0 &&
+    num_fine_searches == 0 && num_fine_rematches == 0 &&
+    num_local_matches == 0 && num_local_fallbacks == 0;
+}
+
+std::ostream& operator<<(std::ostream& os, const MatchingStatistics& stats)
+{
+  const double num_positions = static_cast<double>(std::max<uint64_t>(stats.num_positions, 1));
+  os << stats.num_positions << " positions, "
+    << stats.num_pruned << " pruned by lower bound (" << 100.0 * stats.num_pruned / num_positions << "%), "
+    << stats.num_terminated << " terminated early (" << 100.0 * stats.num_terminated / num_positions << "%), "
+    << stats.num_pyramid_searches << " pyramid searches, " << stats.num_pyramid_misses << " missed the exact minimum, "
+    << stats.num_validity_reused << " validity maps reused, " << stats.num_validity_computed << " computed, "
+    << stats.num_scheduled_searches << " regions searched ahead, " << stats.num_scheduled_hits << " placed from them, "
+    << stats.num_cached_candidates << " from a later candidate, "
+    << stats.num_scheduled_invalidations << " invalidated, "
+    << stats.num_fine_searches << " finer regions searched concurrently, " << stats.num_fine_rematches << " searched again, "
+    << stats.num_local_matches << " placed from local refinement, " << stats.num_local_fallbacks << " fell back to the global search";
+  return os;
+}
+
+static inline float sqdiff_run(const float* texture, const float* kernel, int length)
+{
+  int k = 0;
+  float sum = 0.0f;
+#if CV_SIMD128
+  cv::v_float32x4 acc = cv::v_setzero_f32();
+  for (; k <= length - 4; k += 4)
+  {
+    const cv::v_float32x4 diff = cv::v_load(texture + k) - cv::v_load(kernel + k);
+    acc = cv::v_muladd(diff, diff, acc);
+  }
+  sum = cv::v_reduce_sum(acc);
+#endif
+  for (; k < length; ++k)
+  {
+    const float diff = texture[k] - kernel[k];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+static inline uint64_t sqdiff_run_u16(const uint16_t* texture, const uint16_t* kernel, int length)
+{
+  int k = 0;
+  uint64_t sum = 0;
+#if CV_SIMD128
+  // |t - k|^2 fits into 32 bit, so square after widening and accumulate in 64 bit lanes.
+  cv::v_uint64x2 acc = cv::v_setzero_u64();
+  for (; k <= length - 8; k += 8)
+  {
+    const cv::v_uint16x8 diff = cv::v_absdiff(cv::v_load(texture + k), cv::v_load(kernel + k));
+    cv::v_uint32x4 sqr_lo, sqr_hi;
+    cv::v_mul_expand(diff, diff, sqr_lo, sqr_hi);
+
+    cv::v_uint64x2 sum_0, sum_1, sum_2, sum_3;
+    cv::v_expand(sqr_lo, sum_0, sum_1);
+    cv::v_expand(sqr_hi, sum_2, sum_3);
+    acc += (sum_0 + sum_1) + (sum_2 + sum_3);
+  }
+  cv::v_uint64x2::lane_type acc_lanes[2];
+  cv::v_store(acc_lanes, acc);
+  sum = static_cast<uint64_t>(acc_lanes[0]) + static_cast<uint64_t>(acc_lanes[1]);
+#endif
+  for (; k < length; ++k)
+  {
+    const int64_t diff = static_cast<int64_t>(texture[k]) - static_cast<int64_t>(kernel[k]);
+    sum += static_cast<uint64_t>(diff * diff);
+  }
+  return sum;
+}
+
+static void check_sqdiff_input(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid)
+{
+  if (texture.num_channels() != kernel.num_channels())
+  {
+    throw(std::invalid_argument("sqdiff_masked: Number of channels differs."));
+  }
+
+  if (kernel_runs.size() != kernel.size())
+  {
+    throw(std::invalid_argument("sqdiff_masked: Mask size differs from kernel size."));
+  }
+
+  if (kernel.cols() > texture.cols() || kernel.rows() > texture.rows())
+  {
+    throw(std::invalid_argument("sqdiff_masked: Kernel larger than texture."));
+  }
+
+  if (!valid.empty() && (valid.type() != CV_8UC1 || valid.rows != texture.rows() - kernel.rows() + 1 || valid.cols != texture.cols() - kernel.cols() + 1))
+  {
+    throw(std::invalid_argument("sqdiff_masked: Invalid mask of valid positions."));
+  }
+}
+
+struct Float32Traits
+{
+  typedef float value_type;
+  typedef float accumulator_type;
+
+  static cv::Mat channel(const FeatureVector& features, int i)
+  {
+    return features.channel_float(i);
+  }
+
+  static accumulator_type run(const value_type* texture, const value_type* kernel, int length)
+  {
+    return sqdiff_run(texture, kernel, length);
+  }
+
+  static double scale()
+  {
+    return 1.0;
+  }
+};
+
+struct UInt16Traits
+{
+  typedef uint16_t value_type;
+  typedef uint64_t accumulator_type;
+
+  static cv::Mat channel(const FeatureVector& features, int i)
+  {
+    return features[i];
+  }
+
+  static accumulator_type run(const value_type* texture, const value_type* kernel, int length)
+  {
+    return sqdiff_run_u16(texture, kernel, length);
+  }
+
+  static double scale()
+  {
+    return 1.0 / (65535.0 * 65535.0);
+  }
+};
+
+/*
+ * Shared implementation of the direct kernels. Channels are visited in
+ * channel_order. With a bound, a position is skipped if its lower bound from
+ * texture_integral exceeds it and, with early_termination, abandoned as soon
+ * as its partial cost exceeds it after any run of a channel, so a position
+ * that is clearly worse is not accumulated up to the end of the channel.
+ * Skipped positions are left at FLT_MAX.
+ * Complete costs tighten the bound, so all workers sharing it profit from
+ * each other.
+ */
+template <typename Traits>
+static cv::Mat sqdiff_masked_impl(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, const std::vector<int>& channel_order, SharedBound* bound, bool early_termination, const FeatureIntegral* texture_integral, MatchingStatistics* stats)
+{
+  typedef typename Traits::value_type value_type;
+  typedef typename Traits::accumulator_type accumulator_type;
+
+  check_sqdiff_input(texture, kernel, kernel_runs, valid);
+
+  const int rows_out = texture.rows() - kernel.rows() + 1;
+  const int cols_out = texture.cols() - kernel.cols() + 1;
+
+  const int num_channels = static_cast<int>(channel_order.size());
+  const std::vector<RowRunMask::Run>& runs = kernel_runs.runs();
+  const int num_runs = static_cast<int>(runs.size());
+
+  std::vector<cv::Mat> texture_channels(num_channels);
+  std::vector<cv::Mat> kernel_channels(num_channels);
+
+  // Per channel and run: kernel pointer and texture offset relative to the match position.
+  std::vector<const value_type*> kernel_ptrs(num_channels * num_runs);
+  std::vector<size_t> texture_offsets(num_channels * num_runs);
+
+  for (int i = 0; i < num_channels; ++i)
+  {
+    texture_channels[i] = Traits::channel(texture, channel_order[i]);
+    kernel_channels[i] = Traits::channel(kernel, channel_order[i]);
+
+    const size_t texture_step = texture_channels[i].step1();
+    for (int r = 0; r < num_runs; ++r)
+    {
+      kernel_ptrs[i * num_runs + r] = kernel_channels[i].template ptr<value_type>(runs[r].row) + runs[r].col;
+      texture_offsets[i * num_runs + r] = runs[r].row * texture_step + runs[r].col;
+    }
+  }
+
+  /*
+   * Lower bound: by Cauchy-Schwarz, the SQDIFF of a run of length n is at
+   * least (sum_I - sum_K)^2 / n. Summed over runs and channels, this gives a
+   * bound from four integral image lookups per run instead of n pixels.
+   */
+  const bool prune = bound && texture_integral && !texture_integral->empty();
+  std::vector<double> kernel_run_sums;
+  std::vector<const double*> integral_rows;
+  if (prune)
+  {
+    kernel_run_sums.resize(num_channels * num_runs);
+    for (int i = 0; i < num_channels; ++i)
+    {
+      const cv::Mat kernel_channel = kernel.channel_float(channel_order[i]);
+      for (int r = 0; r < num_runs; ++r)
+      {
+        const float* kernel_row = kernel_channel.ptr<float>(runs[r].row) + runs[r].col;
+        double sum = 0.0;
+        for (int k = 0; k < runs[r].length; ++k)
+        {
+          sum += kernel_row[k];
+        }
+        kernel_run_sums[i * num_runs + r] = sum;
+      }
+    }
+    integral_rows.resize(2 * num_channels * num_runs);
+  }
+
+  // Tolerance for the rounding of the float kernels, so the bound never rejects the true minimum.
+  const double prune_tolerance = 1.0 + 1e-4;
+
+  const double scale = Traits::scale();
+  const bool terminate = bound && early_termination;
+  cv::Mat match(rows_out, cols_out, CV_32FC1, cv::Scalar(FLT_MAX));
+  MatchingStatistics local_stats;
+
+  for (int y = 0; y < rows_out; ++y)
+  {
+    const unsigned char* valid_row = valid.empty() ? nullptr : valid.ptr<unsigned char>(y);
+    float* match_row = match.ptr<float>(y);
+
+    if (prune)
+    {
+      for (int i = 0; i < num_channels; ++i)
+      {
+        const cv::Mat& integral = texture_integral->integrals[channel_order[i]];
+        for (int r = 0; r < num_runs; ++r)
+        {
+          integral_rows[2 * (i * num_runs + r)] = integral.ptr<double>(y + runs[r].row) + runs[r].col;
+          integral_rows[2 * (i * num_runs + r) + 1] = integral.ptr<double>(y + runs[r].row + 1) + runs[r].col;
+        }
+      }
+    }
+
+    for (int x = 0; x < cols_out; ++x)
+    {
+      if (valid_row && valid_row[x] == 0)
+      {
+        continue;
+      }
+      ++local_stats.num_positions;
+
+      if (prune)
+      {
+        const double bound_value = bound->value() * prune_tolerance;
+        double lower_bound = 0.0;
+        for (int j = 0; j < num_channels * num_runs && lower_bound <= bound_value; ++j)
+        {
+          const double* row_top = integral_rows[2 * j] + x;
+          const double* row_bottom = integral_rows[2 * j + 1] + x;
+          const int length = runs[j % num_runs].length;
+          const double diff = (row_bottom[length] - row_top[length] - row_bottom[0] + row_top[0]) - kernel_run_sums[j];
+          lower_bound += diff * diff / length;
+        }
+
+        if (lower_bound > bound_value)
+        {
+          ++local_stats.num_pruned;
+          continue;
+        }
+      }
+
+      accumulator_type sum = 0;
+      bool terminated = false;
+      for (int i = 0; i < num_channels && !terminated; ++i)
+      {
+        // The bound is read once per channel, in units of the accumulator, and checked after every run.
+        const double limit = terminate ? bound->value() / scale : DBL_MAX;
+        const value_type* texture_origin = texture_channels[i].template ptr<value_type>(y) + x;
+        for (int r = 0; r < num_runs && !terminated; ++r)
+        {
+          sum += Traits::run(texture_origin + texture_offsets[i * num_runs + r], kernel_ptrs[i * num_runs + r], runs[r].length);
+          terminated = static_cast<double>(sum) > limit;
+        }
+      }
+
+      if (terminated)
+      {
+        ++local_stats.num_terminated;
+        continue;
+      }
+
+      const float cost = static_cast<float>(scale * static_cast<double>(sum));
+      match_row[x] = cost;
+      if (bound)
+      {
+        bound->update(cost);
+      }
+    }
+  }
+
+  if (stats)
+  {
+    *stats += local_stats;
+  }
+
+  return match;
+}
+
+static std::vector<int> identity_order(int num_channels)
+{
+  std::vector<int> order(num_channels);
+  for (int i = 0; i < num_channels; ++i)
+  {
+    order[i] = i;
+  }
+  return order;
+}
+
+cv::Mat sqdiff_masked(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid)
+{
+  return sqdiff_masked_impl<Float32Traits>(texture, kernel, kernel_runs, valid, identity_order(kernel.num_channels()), nullptr, false, nullptr, nullptr);
+}
+
+cv::Mat sqdiff_masked_u16(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid)
+{
+  return sqdiff_masked_impl<UInt16Traits>(texture, kernel, kernel_runs, valid, identity_order(kernel.num_channels()), nullptr, false, nullptr, nullptr);
+}
+
+cv::Mat sqdiff_masked(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision)
+{
+  if (precision == MatchingPrecision::UInt16)
+  {
+    return sqdiff_masked_u16(texture, kernel, kernel_runs, valid);
+  }
+  return sqdiff_masked(texture, kernel, kernel_runs, valid);
+}
+
+cv::Mat sqdiff_masked_bounded(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision, const std::vector<int>& channel_order, SharedBound& bound, bool early_termination, const FeatureIntegral* texture_integral, MatchingStatistics* stats)
+{
+  if (static_cast<int>(channel_order.size()) != kernel.num_channels())
+  {
+    throw(std::invalid_argument("sqdiff_masked_bounded: Channel order does not cover all channels."));
+  }
+
+  if (texture_integral && !texture_integral->empty() && texture_integral->num_channels() != texture.num_channels())
+  {
+    throw(std::invalid_argument("sqdiff_masked_bounded: Integral images do not match the texture."));
+  }
+
+  if (precision == MatchingPrecision::UInt16)
+  {
+    return sqdiff_masked_impl<UInt16Traits>(texture, kernel, kernel_runs, valid, channel_order, &bound, early_termination, texture_integral, stats);
+  }
+  return sqdiff_masked_impl<Float32Traits>(texture, kernel, kernel_runs, valid, channel_order, &bound, early_termination, texture_integral, stats);
+}
+
+std::vector<int> channel_order_by_energy(const FeatureVector& kernel, const RowRunMask& kernel_runs)
+{
+  const int num_channels = kernel.num_channels();
+  std::vector<double> energy(num_channels, 0.0);
+  for (int c = 0; c < num_channels; ++c)
+  {
+    const cv::Mat channel = kernel.channel_float(c);
+    for (const RowRunMask::Run& run : kernel_runs.runs())
+    {
+      const float* kernel_row = channel.ptr<float>(run.row) + run.col;
+      for (int k = 0; k < run.length; ++k)
+      {
+        energy[c] += kernel_row[k] * kernel_row[k];
+      }
+    }
+  }
+
+  std::vector<int> order = identity_order(num_channels);
+  std::stable_sort(order.begin(), order.end(), [&energy](int lhs, int rhs) { return energy[lhs] > energy[rhs]; });
+  return order;
+}
+
+MatchingPrecision matching_precision_from_string(const std::string& str)
+{
+  if (str == "float32")
+  {
+    return MatchingPrecision::Float32;
+  }
+  else if (str == "uint16")
+  {
+    return MatchingPrecision::UInt16;
+  }
+  throw(std::invalid_argument("Unknown matching precision: " + str));
+}
+
+std::string to_string(MatchingPrecision precision)
+{
+  return precision == MatchingPrecision::UInt16 ? "uint16" : "float32";
+}
@@ -0,0 +1,223 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_SQDIFF_KERNELS_HPP_
+#define TRLIB_SQDIFF_KERNELS_HPP_
+
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "feature_vector.hpp"
+
+/*
+ * Arithmetic used by the direct SQDIFF kernels. Float32 works on the float
+ * feature store, UInt16 directly on the quantized CV_16U channels with exact
+ * integer accumulation, which halves the memory traffic.
+ */
+enum class MatchingPrecision
+{
+  Float32,
+  UInt16
+};
+
+/*
+ * Sparse representation of a binary kernel mask as horizontal runs of active
+ * pixels. Built once per patch region, it lets the SQDIFF kernels skip masked
+ * out pixels entirely instead of multiplying them with zero.
+ */
+class RowRunMask
+{
+public:
+  struct Run
+  {
+    int row;
+    int col;
+    int length;
+  };
+
+  RowRunMask() = default;
+  explicit RowRunMask(cv::Mat mask);
+
+  bool empty() const
+  {
+    return m_runs.empty();
+  }
+
+  int num_pixels() const
+  {
+    return m_num_pixels;
+  }
+
+  cv::Size size() const
+  {
+    return m_size;
+  }
+
+  const std::vector<Run>& runs() const
+  {
+    return m_runs;
+  }
+
+private:
+  std::vector<Run> m_runs;
+  cv::Size m_size;
+  int m_num_pixels = 0;
+};
+
+/*
+ * Masked multi-channel SQDIFF of kernel over texture, equivalent to summing
+ * cv::matchTemplate(CV_TM_SQDIFF) with a binary mask over all channels.
+ * All channels are accumulated in one pass over the active pixels. If valid is
+ * given (CV_8UC1, size of the result), only positions with valid != 0 are
+ * evaluated; all others are set to FLT_MAX.
+ */
+cv::Mat sqdiff_masked(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid = cv::Mat());
+
+/*
+ * Same as sqdiff_masked, but computed on the CV_16U channels. Squared
+ * differences are accumulated exactly in 64 bit integers and scaled by
+ * 1/65535^2 at the end, so costs are comparable to the float kernels.
+ */
+cv::Mat sqdiff_masked_u16(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid = cv::Mat());
+
+/*
+ * Dispatches to sqdiff_masked or sqdiff_masked_u16.
+ */
+cv::Mat sqdiff_masked(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision);
+
+/*
+ * Best cost found so far, shared between the workers matching one region.
+ * Used as upper bound for partial-distance early termination.
+ */
+class SharedBound
+{
+public:
+  explicit SharedBound(float value = FLT_MAX) :
+    m_value(value)
+  {}
+
+  float value() const
+  {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+  void update(float cost)
+  {
+    float current = m_value.load(std::memory_order_relaxed);
+    while (cost < current && !m_value.compare_exchange_weak(current, cost, std::memory_order_relaxed))
+    {
+    }
+  }
+
+private:
+  std::atomic<float> m_value;
+};
+
+/*
+ * Per-channel integral images (CV_64FC1) of a feature stack, used for lower
+ * bounds of the SQDIFF cost that do not touch the individual pixels.
+ */
+class FeatureIntegral
+{
+public:
+  FeatureIntegral() = default;
+  explicit FeatureIntegral(const FeatureVector& features);
+
+  bool empty() const
+  {
+    return integrals.empty();
+  }
+
+  int num_channels() const
+  {
+    return static_cast<int>(integrals.size());
+  }
+
+  std::vector<cv::Mat> integrals;
+};
+
+/*
+ * Counters of the CPU matchers: valid positions visited by the bounded kernel,
+ * positions rejected by the lower bound, positions abandoned during exact
+ * accumulation, pyramid searches and pyramid searches that missed the exact
+ * minimum (only known in exact validation mode). The matchers also count
+ * validity maps reused from the cache or computed from scratch, regions
+ * searched ahead of their turn together with how many of them were placed from
+ * their candidates (from a candidate after the best one in
+ * num_cached_candidates) or invalidated, and finer
+ * adaptive regions searched concurrently together with how many of them had to
+ * be searched again. Local refinement counts finer regions placed from the
+ * local search and regions that fell back to the global search.
+ */
+struct MatchingStatistics
+{
+  uint64_t num_positions = 0;
+  uint64_t num_pruned = 0;
+  uint64_t num_terminated = 0;
+  uint64_t num_pyramid_searches = 0;
+  uint64_t num_pyramid_misses = 0;
+  uint64_t num_cached_candidates = 0;
+  uint64_t num_validity_reused = 0;
+  uint64_t num_validity_computed = 0;
+  uint64_t num_scheduled_searches = 0;
+  uint64_t num_scheduled_hits = 0;
+  uint64_t num_scheduled_invalidations = 0;
+  uint64_t num_fine_searches = 0;
+  uint64_t num_fine_rematches = 0;
+  uint64_t num_local_matches = 0;
+  uint64_t num_local_fallbacks = 0;
+
+  MatchingStatistics& operator+=(const MatchingStatistics& rhs);
+
+  // No counter has been incremented. Counters added above must be added here and to operator+=.
+  bool empty() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const MatchingStatistics& stats);
+
+/*
+ * Direct SQDIFF against a bound shared between workers. With texture_integral,
+ * positions whose lower bound already exceeds the bound are skipped. With
+ * early_termination, channels are accumulated in channel_order and a position
+ * is abandoned once its partial cost exceeds the bound, checked after every
+ * run of the kernel mask. Skipped positions are
+ * set to FLT_MAX, so the minimum over the result is the same as for
+ * sqdiff_masked whenever it is below the bound.
+ */
+cv::Mat sqdiff_masked_bounded(const FeatureVector& texture, const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision, const std::vector<int>& channel_order, SharedBound& bound, bool early_termination, const FeatureIntegral* texture_integral = nullptr, MatchingStatistics* stats = nullptr);
+
+/*
+ * Orders channels by descending energy of the kernel under its mask, so the
+ * channels that are expected to contribute most to the cost come first.
+ */
+std::vector<int> channel_order_by_energy(const FeatureVector& kernel, const RowRunMask& kernel_runs);
+
+MatchingPrecision matching_precision_from_string(const std::string& str);
+std::string to_string(MatchingPrecision precision);
+
+#endif /* TRLIB_SQDIFF_KERNELS_HPP_ */
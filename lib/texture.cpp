@@ -160,6 +160,81 @@ void Texture::mask_patch(std::vector<Texture>& rotated_textures, int index, cv::
   }
 }
 
+/*
+ * 1 where mask() of texture is 0 inside rect, 0 elsewhere.
+ */
+static cv::Mat used_pixels(const Texture& texture, cv::Rect rect)
+{
+  cv::Mat available;
+  cv::min(texture.mask_done(rect), texture.mask_rotation(rect), available);
+  cv::Mat used = (available == 0);
+  return used / 255;
+}
+
+std::vector<cv::Rect> Texture::update_mask_done(std::vector<Texture>& rotated_textures, int index, cv::Rect rect, const cv::Mat& mask, bool consume)
+{
+  // Patch pixels are 0 in the local source mask, everything else (including the border) stays 1.
+  cv::Mat mask_source(rect.size(), CV_8UC1, cv::Scalar(mask.empty() ? 0 : 1));
+  if (!mask.empty())
+  {
+    mask_source.setTo(0, mask);
+  }
+
+  const std::vector<cv::Point2f> corners_source = {
+    cv::Point2f(static_cast<float>(rect.x), static_cast<float>(rect.y)),
+    cv::Point2f(static_cast<float>(rect.x + rect.width), static_cast<float>(rect.y)),
+    cv::Point2f(static_cast<float>(rect.x), static_cast<float>(rect.y + rect.height)),
+    cv::Point2f(static_cast<float>(rect.x + rect.width), static_cast<float>(rect.y + rect.height))
+  };
+
+  // One pixel for nearest neighbor rounding, one for the erosion and one to keep the erosion away from the box border.
+  const int halo = 3;
+
+  std::vector<cv::Rect> boxes;
+  for (Texture& texture : rotated_textures)
+  {
+    const cv::Mat transform_patch = AffineTransformation::concat(texture.transformation_matrix, rotated_textures[index].transformation_matrix_inv);
+
+    std::vector<cv::Point2f> corners;
+    cv::transform(corners_source, corners, transform_patch);
+    cv::Rect box = cv::boundingRect(corners);
+    box = cv::Rect(box.x - halo, box.y - halo, box.width + 2 * halo, box.height + 2 * halo) & cv::Rect(cv::Point(0, 0), texture.mask_done.size());
+    boxes.push_back(box);
+    if (box.area() == 0)
+    {
+      continue;
+    }
+
+    // Map local source coordinates directly into the box.
+    cv::Mat transform_box = transform_patch.clone();
+    transform_box.at<double>(0, 2) += transform_box.at<double>(0, 0) * rect.x + transform_box.at<double>(0, 1) * rect.y - box.x;
+    transform_box.at<double>(1, 2) += transform_box.at<double>(1, 0) * rect.x + transform_box.at<double>(1, 1) * rect.y - box.y;
+
+    cv::Mat mask_rotated;
+    cv::warpAffine(mask_source, mask_rotated, transform_box, box.size(), cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(1));
+    cv::erode(mask_rotated, mask_rotated, cv::Mat::ones(3, 3, CV_8UC1));
+
+    cv::Mat mask_done_box = texture.mask_done(box);
+    if (consume)
+    {
+      cv::min(mask_done_box, mask_rotated, mask_done_box);
+    }
+    else
+    {
+      mask_rotated = 1 - mask_rotated;
+      cv::max(mask_done_box, mask_rotated, mask_done_box);
+    }
+
+    if (!texture.mask_used_integral.empty())
+    {
+      const cv::Rect tiles = texture.mask_used_integral.tiles(box);
+      texture.mask_used_integral.update(tiles, used_pixels(texture, tiles));
+    }
+  }
+
+  return boxes;
+}
+
 Texture Texture::operator()(const cv::Range& row_range, const cv::Range& col_range)
 {
   Texture texture_out;
@@ -182,6 +257,20 @@ Texture Texture::operator()(const cv::Rect& rect)
   return (*this)(cv::Range(rect.y, rect.y + rect.height), cv::Range(rect.x, rect.x + rect.width));
 }
 
+Texture Texture::match_rows(const cv::Range& output_rows, cv::Size kernel_size)
+{
+  const cv::Range rows(output_rows.start, output_rows.end + kernel_size.height - 1);
+  Texture texture_out = (*this)(rows, cv::Range::all());
+
+  // Integral images are one row larger than the features.
+  for (const cv::Mat& integral : response_integral.integrals)
+  {
+    texture_out.response_integral.integrals.push_back(integral.rowRange(rows.start, rows.end + 1));
+  }
+
+  return texture_out;
+}
+
 /*
 cv::Mat Texture::template_match_gpu(const Texture& kernel) const
 {
@@ -240,8 +329,6 @@ cv::Mat Texture::template_match_gpu(const Texture& kernel) const
 */
 cv::Mat Texture::template_match(const Texture& kernel) const
 {
-  cv::Mat response_float, kernel_response_float;
-
   const int rows_out = response.rows() - kernel.response.rows() + 1;
   const int cols_out = response.cols() - kernel.response.cols() + 1;
 
@@ -250,9 +337,7 @@ cv::Mat Texture::template_match(const Texture& kernel) const
 
   for (int i = 0; i < response.num_channels(); ++i)
   {
-    response[i].convertTo(response_float, CV_32FC1, 1.0/65535.0);
-    kernel.response[i].convertTo(kernel_response_float, CV_32FC1, 1.0 / 65535.0);
-    cv::matchTemplate(response_float, kernel_response_float, match, CV_TM_SQDIFF);
+    cv::matchTemplate(response.channel_float(i), kernel.response.channel_float(i), match, CV_TM_SQDIFF);
     match_sum += match;
   }
 
@@ -261,8 +346,6 @@ cv::Mat Texture::template_match(const Texture& kernel) const
 
 cv::Mat Texture::template_match(const Texture& kernel, cv::Mat mask) const
 {
-  cv::Mat response_float,  kernel_response_float;
-
   const int rows_out = response.rows() - kernel.response.rows() + 1;
   const int cols_out = response.cols() - kernel.response.cols() + 1;
 
@@ -274,27 +357,115 @@ cv::Mat Texture::template_match(const Texture& kernel, cv::Mat mask) const
 
   for (int i = 0; i < response.num_channels(); ++i)
   {
-    response[i].convertTo(response_float, CV_32FC1, 1.0/65535.0);
-    kernel.response[i].convertTo(kernel_response_float, CV_32FC1, 1.0 / 65535.0);
-    cv::matchTemplate(response_float, kernel_response_float, match, CV_TM_SQDIFF, mask_float);
+    cv::matchTemplate(response.channel_float(i), kernel.response.channel_float(i), match, CV_TM_SQDIFF, mask_float);
     match_sum += match;
   }
 
   return match_sum;
 }
 
+cv::Mat Texture::template_match(const FeatureSpectrum& kernel_spectrum) const
+{
+  if (response_spectrum.empty())
+  {
+    throw(std::logic_error("Texture::template_match: No response spectrum available."));
+  }
+  return sqdiff_fft(response_spectrum, kernel_spectrum);
+}
+
+cv::Mat Texture::template_match(const Texture& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision) const
+{
+  return template_match(kernel.response, kernel_runs, valid, precision);
+}
+
+cv::Mat Texture::template_match(const Texture& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision, const std::vector<int>& channel_order, SharedBound& bound, bool early_termination, bool lower_bound_pruning, MatchingStatistics* stats) const
+{
+  return template_match(kernel.response, kernel_runs, valid, precision, channel_order, bound, early_termination, lower_bound_pruning, stats);
+}
+
+cv::Mat Texture::template_match(const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision) const
+{
+  return sqdiff_masked(response, kernel, kernel_runs, valid, precision);
+}
+
+cv::Mat Texture::template_match(const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision, const std::vector<int>& channel_order, SharedBound& bound, bool early_termination, bool lower_bound_pruning, MatchingStatistics* stats) const
+{
+  if (lower_bound_pruning && response_integral.empty())
+  {
+    const FeatureIntegral integral(response);
+    return sqdiff_masked_bounded(response, kernel, kernel_runs, valid, precision, channel_order, bound, early_termination, &integral, stats);
+  }
+  return sqdiff_masked_bounded(response, kernel, kernel_runs, valid, precision, channel_order, bound, early_termination, lower_bound_pruning ? &response_integral : nullptr, stats);
+}
+
+void Texture::compute_response_spectrum(cv::Size dft_size)
+{
+  response_spectrum = FeatureSpectrum(response, dft_size);
+}
+
+void Texture::compute_response_integral()
+{
+  response_integral = FeatureIntegral(response);
+}
+
+void Texture::compute_response_pyramid(int num_levels)
+{
+  response_pyramid = PyramidMatcher::build_pyramid(response, num_levels);
+}
+
+void Texture::compute_mask_integral()
+{
+  mask_used_integral = TiledIntegral(used_pixels(*this, cv::Rect(cv::Point(0, 0), mask_done.size())));
+}
+
+cv::Mat Texture::valid_rect_positions(cv::Size kernel_size, int* num_valid) const
+{
+  const cv::Size size(mask_done.cols - kernel_size.width + 1, mask_done.rows - kernel_size.height + 1);
+  if (num_valid)
+  {
+    *num_valid = 0;
+  }
+  if (size.width <= 0 || size.height <= 0)
+  {
+    return cv::Mat();
+  }
+
+  cv::Mat valid(size, CV_8UC1);
+  int n = 0;
+  for (int y = 0; y < size.height; ++y)
+  {
+    unsigned char* ptr_valid = valid.ptr<unsigned char>(y);
+    for (int x = 0; x < size.width; ++x)
+    {
+      const int used = mask_used_integral.sum(cv::Rect(x, y, kernel_size.width, kernel_size.height));
+      ptr_valid[x] = used == 0 ? 255 : 0;
+      n += used == 0;
+    }
+  }
+
+  if (num_valid)
+  {
+    *num_valid = n;
+  }
+  return valid;
+}
+
 Texture Texture::clone() const
 {
   Texture rhs;
   rhs.texture = texture.clone();
   rhs.mask_done = mask_done.clone();
   rhs.mask_rotation = mask_rotation.clone();
+  rhs.mask_used_integral = mask_used_integral.clone();
   rhs.transformation_matrix = transformation_matrix.clone();
   rhs.transformation_matrix_inv = transformation_matrix_inv.clone();
   rhs.angle_rad = angle_rad;
   rhs.dpi = dpi;
   rhs.scale = scale;
   rhs.response = response;
+  rhs.response_spectrum = response_spectrum;
+  rhs.response_integral = response_integral;
+  rhs.response_pyramid = response_pyramid;
   rhs.filename = filename;
   return rhs;
 }
@@ -305,7 +476,11 @@ void Texture::downsample_nn(int factor)
   cv::resize(texture, texture, cv::Size(), f, f, cv::INTER_AREA);
   cv::resize(mask_done, mask_done, cv::Size(), f, f, cv::INTER_NEAREST);
   cv::resize(mask_rotation, mask_rotation, cv::Size(), f, f, cv::INTER_NEAREST);
+  mask_used_integral = TiledIntegral();
   response.downsample_nn(factor);
+  response_spectrum = FeatureSpectrum();
+  response_integral = FeatureIntegral();
+  response_pyramid.clear();
   scale /= factor;
 }
 
@@ -27,8 +27,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <opencv2/opencv.hpp>
 
 #include "bezier_curve.hpp"
+#include "feature_spectrum.hpp"
 #include "feature_vector.hpp"
+#include "pyramid_matcher.hpp"
+#include "sqdiff_kernels.hpp"
 #include "texture_marker.hpp"
+#include "tiled_integral.hpp"
 #include "serializable.hpp"
 #include <idgen.hpp>
 
@@ -88,6 +92,13 @@ public:
   Texture operator()(const cv::Range& row_range, const cv::Range& col_range);
   Texture operator()(const cv::Rect& rect);
 
+  /*
+   * View of the rows needed to match a kernel of kernel_size at the positions
+   * in output_rows, for splitting a match into tiles of rows. The response
+   * integral is sliced along.
+   */
+  Texture match_rows(const cv::Range& output_rows, cv::Size kernel_size);
+
   TextureRegion get_regions(cv::Rect region, cv::Mat edge_image);
 
   cv::Mat mask() const
@@ -99,6 +110,16 @@ public:
 
   static void mask_patch(std::vector<Texture>& rotated_textures, int index, cv::Point anchor, const std::vector<cv::Point>& patch);
 
+  /*
+   * Consume (or release) the pixels of a patch placed at rect in rotation index
+   * in mask_done of all rotations. mask marks the patch pixels inside rect, an
+   * empty mask covers all of rect. Consumed areas grow by one pixel (3x3
+   * erosion). Only the transformed bounding box of rect plus this halo is
+   * touched in each rotation; these boxes are returned (empty if a rotation
+   * was not touched). Existing used-pixel integrals are updated as well.
+   */
+  static std::vector<cv::Rect> update_mask_done(std::vector<Texture>& rotated_textures, int index, cv::Rect rect, const cv::Mat& mask, bool consume);
+
   cv::Mat mask_rotation_inv() const
   {
     return cv::Scalar(255) - mask_rotation;
@@ -110,6 +131,26 @@ public:
 
   cv::Mat template_match(const Texture& kernel) const;
   cv::Mat template_match(const Texture& kernel, cv::Mat mask) const;
+  cv::Mat template_match(const FeatureSpectrum& kernel_spectrum) const;
+  cv::Mat template_match(const Texture& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision = MatchingPrecision::Float32) const;
+  cv::Mat template_match(const Texture& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision, const std::vector<int>& channel_order, SharedBound& bound, bool early_termination, bool lower_bound_pruning, MatchingStatistics* stats) const;
+  cv::Mat template_match(const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision = MatchingPrecision::Float32) const;
+  cv::Mat template_match(const FeatureVector& kernel, const RowRunMask& kernel_runs, cv::Mat valid, MatchingPrecision precision, const std::vector<int>& channel_order, SharedBound& bound, bool early_termination, bool lower_bound_pruning, MatchingStatistics* stats) const;
+
+  void compute_response_spectrum(cv::Size dft_size);
+  void compute_response_integral();
+  void compute_response_pyramid(int num_levels);
+
+  /*
+   * Summed-area table of the pixels not available in mask(), kept per tile so
+   * that update_mask_done only recomputes the tiles it touches.
+   * valid_rect_positions answers for every position whether a kernel_size
+   * rectangle only covers available pixels (255, size texture - kernel_size +
+   * 1) from a constant number of lookups each, and returns the number of such
+   * positions in num_valid.
+   */
+  void compute_mask_integral();
+  cv::Mat valid_rect_positions(cv::Size kernel_size, int* num_valid = nullptr) const;
 
   std::vector<cv::Vec3f> find_markers(double marker_size_mm, int num_markers);
 
@@ -118,6 +159,7 @@ public:
   cv::Mat texture;
   cv::Mat mask_done;
   cv::Mat mask_rotation;
+  TiledIntegral mask_used_integral;
   cv::Mat transformation_matrix;
   cv::Mat transformation_matrix_inv;
 
@@ -129,6 +171,9 @@ public:
   double dpi;
 
   FeatureVector response;
+  FeatureSpectrum response_spectrum;
+  FeatureIntegral response_integral;
+  std::vector<FeatureVector> response_pyramid;
 
   boost::filesystem::path filename;
 
@@ -0,0 +1,97 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+#include <omp.h>
+#include <opencv2/opencv.hpp>
+
+namespace
+{
+  int configured_threads = 0;
+
+  int default_threads()
+  {
+    // Captured before the first resize, so it still reflects OMP_NUM_THREADS.
+    static const int threads = omp_get_max_threads();
+    return threads;
+  }
+}
+
+void ThreadPool::set_num_threads(int num_threads)
+{
+  default_threads();
+  configured_threads = std::max(num_threads, 0);
+  omp_set_num_threads(ThreadPool::num_threads());
+  cv::setNumThreads(ThreadPool::num_threads());
+}
+
+int ThreadPool::num_threads()
+{
+  return configured_threads > 0 ? configured_threads : default_threads();
+}
+
+ThreadPool::Scope::Scope(int num_threads) :
+  m_num_threads(configured_threads),
+  m_omp_threads(omp_get_max_threads()),
+  m_omp_dynamic(omp_get_dynamic()),
+  m_cv_threads(cv::getNumThreads())
+{
+  set_num_threads(num_threads);
+  if (num_threads > 0)
+  {
+    omp_set_dynamic(0);
+  }
+}
+
+ThreadPool::Scope::~Scope()
+{
+  configured_threads = m_num_threads;
+  omp_set_num_threads(m_omp_threads);
+  omp_set_dynamic(m_omp_dynamic);
+  cv::setNumThreads(m_cv_threads);
+}
+
+ThreadPool::ParallelScope::ParallelScope(bool active) :
+  m_active(active && !omp_in_parallel()),
+  m_cv_threads(0)
+{
+  if (m_active)
+  {
+    m_cv_threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+  }
+}
+
+ThreadPool::ParallelScope::~ParallelScope()
+{
+  if (m_active)
+  {
+    cv::setNumThreads(m_cv_threads);
+  }
+}
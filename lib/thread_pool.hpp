@@ -0,0 +1,85 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_THREAD_POOL_HPP_
+#define TRLIB_THREAD_POOL_HPP_
+
+/*
+ * Single thread count for trlib's OpenMP loops and OpenCV's parallel backend.
+ * Feature computation, masking and merging run their OpenCV calls serially
+ * from the main thread and let OpenCV use the whole pool. Matching runs
+ * OpenMP loops over textures and tiles, inside which OpenCV has to stay
+ * single-threaded, or every worker starts a parallel backend of its own.
+ */
+class ThreadPool
+{
+public:
+  /*
+   * Sizes both OpenMP and OpenCV. Zero restores the runtime default, which
+   * honours OMP_NUM_THREADS.
+   */
+  static void set_num_threads(int num_threads);
+  static int num_threads();
+
+  /*
+   * Sizes the pool for the lifetime of the scope and pins the OpenMP team
+   * size. Meant for the top of a tool's main().
+   */
+  class Scope
+  {
+  public:
+    explicit Scope(int num_threads);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    int m_num_threads;
+    int m_omp_threads;
+    int m_omp_dynamic;
+    int m_cv_threads;
+  };
+
+  /*
+   * Keeps OpenCV single-threaded while OpenMP loops are running. Opened in
+   * the serial code right before the loops; inside a parallel region it does
+   * nothing, so functions that open one can be called from OpenMP workers.
+   * With active = false it does nothing either, for loops that are only
+   * parallel above some size.
+   */
+  class ParallelScope
+  {
+  public:
+    explicit ParallelScope(bool active = true);
+    ~ParallelScope();
+
+    ParallelScope(const ParallelScope&) = delete;
+    ParallelScope& operator=(const ParallelScope&) = delete;
+
+  private:
+    bool m_active;
+    int m_cv_threads;
+  };
+};
+
+#endif /* TRLIB_THREAD_POOL_HPP_ */
@@ -0,0 +1,180 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tiled_integral.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+TiledIntegral::TiledIntegral(const cv::Mat& values, int tile_shift) :
+  m_tile_shift(tile_shift),
+  m_size(values.size())
+{
+  if (values.type() != CV_8UC1)
+  {
+    throw(std::invalid_argument("TiledIntegral: values must be of type CV_8UC1."));
+  }
+
+  const int tile_size = 1 << m_tile_shift;
+  const int num_tiles_x = (m_size.width + tile_size - 1) >> m_tile_shift;
+  const int num_tiles_y = (m_size.height + tile_size - 1) >> m_tile_shift;
+
+  m_local = cv::Mat::zeros(m_size.height + 1, m_size.width + 1, CV_32SC1);
+  m_tile_rows = cv::Mat::zeros(m_size.height + 1, num_tiles_x, CV_32SC1);
+  m_tile_cols = cv::Mat::zeros(num_tiles_y, m_size.width + 1, CV_32SC1);
+  m_counts = cv::Mat::zeros(num_tiles_y, num_tiles_x, CV_32SC1);
+  m_tiles = cv::Mat::zeros(num_tiles_y + 1, num_tiles_x + 1, CV_32SC1);
+  m_rows = cv::Mat::zeros(m_size.height + 1, num_tiles_x + 1, CV_32SC1);
+  m_cols = cv::Mat::zeros(num_tiles_y + 1, m_size.width + 1, CV_32SC1);
+
+  const cv::Rect all(cv::Point(0, 0), m_size);
+  if (all.area() > 0)
+  {
+    update(all, values);
+  }
+}
+
+cv::Rect TiledIntegral::tiles(cv::Rect box) const
+{
+  box &= cv::Rect(cv::Point(0, 0), m_size);
+  if (box.area() == 0)
+  {
+    return cv::Rect();
+  }
+
+  const int x_begin = (box.x >> m_tile_shift) << m_tile_shift;
+  const int y_begin = (box.y >> m_tile_shift) << m_tile_shift;
+  const int x_end = std::min((((box.x + box.width - 1) >> m_tile_shift) + 1) << m_tile_shift, m_size.width);
+  const int y_end = std::min((((box.y + box.height - 1) >> m_tile_shift) + 1) << m_tile_shift, m_size.height);
+  return cv::Rect(x_begin, y_begin, x_end - x_begin, y_end - y_begin);
+}
+
+void TiledIntegral::update(cv::Rect tiles, const cv::Mat& values)
+{
+  if (values.type() != CV_8UC1 || values.size() != tiles.size())
+  {
+    throw(std::invalid_argument("TiledIntegral::update: values must be of type CV_8UC1 and of the size of tiles."));
+  }
+
+  if (tiles.area() == 0)
+  {
+    return;
+  }
+
+  const int tile_size = 1 << m_tile_shift;
+  const int tx_begin = tiles.x >> m_tile_shift;
+  const int ty_begin = tiles.y >> m_tile_shift;
+  const int tx_end = ((tiles.x + tiles.width - 1) >> m_tile_shift) + 1;
+  const int ty_end = ((tiles.y + tiles.height - 1) >> m_tile_shift) + 1;
+
+  for (int ty = ty_begin; ty < ty_end; ++ty)
+  {
+    for (int tx = tx_begin; tx < tx_end; ++tx)
+    {
+      const cv::Rect tile = cv::Rect(tx << m_tile_shift, ty << m_tile_shift, tile_size, tile_size) & cv::Rect(cv::Point(0, 0), m_size);
+      update_tile(tx, ty, values(tile - tiles.tl()));
+    }
+  }
+
+  // Partial tiles across the changed tile rows.
+  const int num_tiles_x = m_counts.cols;
+  const int y_end = std::min(ty_end << m_tile_shift, m_size.height + 1);
+  for (int y = ty_begin << m_tile_shift; y < y_end; ++y)
+  {
+    const int* ptr_tile_rows = m_tile_rows.ptr<int>(y);
+    int* ptr_rows = m_rows.ptr<int>(y);
+    for (int tx = 0; tx < num_tiles_x; ++tx)
+    {
+      ptr_rows[tx + 1] = ptr_rows[tx] + ptr_tile_rows[tx];
+    }
+  }
+
+  // Partial tiles down the changed tile columns.
+  const int num_tiles_y = m_counts.rows;
+  const int x_begin = tx_begin << m_tile_shift;
+  const int x_end = std::min(tx_end << m_tile_shift, m_size.width + 1);
+  for (int ty = 0; ty < num_tiles_y; ++ty)
+  {
+    const int* ptr_tile_cols = m_tile_cols.ptr<int>(ty);
+    const int* ptr_cols = m_cols.ptr<int>(ty);
+    int* ptr_cols_next = m_cols.ptr<int>(ty + 1);
+    for (int x = x_begin; x < x_end; ++x)
+    {
+      ptr_cols_next[x] = ptr_cols[x] + ptr_tile_cols[x];
+    }
+  }
+
+  // Whole tiles, only one entry per tile.
+  for (int ty = 0; ty < num_tiles_y; ++ty)
+  {
+    const int* ptr_counts = m_counts.ptr<int>(ty);
+    const int* ptr_tiles = m_tiles.ptr<int>(ty);
+    int* ptr_tiles_next = m_tiles.ptr<int>(ty + 1);
+    for (int tx = 0; tx < num_tiles_x; ++tx)
+    {
+      ptr_tiles_next[tx + 1] = ptr_tiles_next[tx] + ptr_tiles[tx + 1] - ptr_tiles[tx] + ptr_counts[tx];
+    }
+  }
+}
+
+void TiledIntegral::update_tile(int tx, int ty, const cv::Mat& values)
+{
+  cv::Mat integral;
+  cv::integral(values, integral, CV_32S);
+
+  // Entries on the far border of a whole tile belong to the next tile, on the image border to this one.
+  const int tile_size = 1 << m_tile_shift;
+  const int rows = std::min(values.rows + 1, tile_size);
+  const int cols = std::min(values.cols + 1, tile_size);
+  const int x0 = tx << m_tile_shift;
+  const int y0 = ty << m_tile_shift;
+
+  for (int r = 0; r < rows; ++r)
+  {
+    const int* ptr_integral = integral.ptr<int>(r);
+    std::copy(ptr_integral, ptr_integral + cols, m_local.ptr<int>(y0 + r) + x0);
+    m_tile_rows.ptr<int>(y0 + r)[tx] = ptr_integral[values.cols];
+  }
+
+  const int* ptr_integral_bottom = integral.ptr<int>(values.rows);
+  std::copy(ptr_integral_bottom, ptr_integral_bottom + cols, m_tile_cols.ptr<int>(ty) + x0);
+  m_counts.ptr<int>(ty)[tx] = ptr_integral_bottom[values.cols];
+}
+
+TiledIntegral TiledIntegral::clone() const
+{
+  TiledIntegral rhs;
+  rhs.m_tile_shift = m_tile_shift;
+  rhs.m_size = m_size;
+  rhs.m_local = m_local.clone();
+  rhs.m_tile_rows = m_tile_rows.clone();
+  rhs.m_tile_cols = m_tile_cols.clone();
+  rhs.m_counts = m_counts.clone();
+  rhs.m_tiles = m_tiles.clone();
+  rhs.m_rows = m_rows.clone();
+  rhs.m_cols = m_cols.clone();
+  return rhs;
+}
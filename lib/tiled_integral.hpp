@@ -0,0 +1,101 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_TILED_INTEGRAL_HPP_
+#define TRLIB_TILED_INTEGRAL_HPP_
+
+#include <opencv2/opencv.hpp>
+
+/*
+ * Summed-area table of a CV_8UC1 image that can be updated tile by tile. The
+ * sum over [0, x) x [0, y) is split into the whole tiles above left of
+ * (x, y), the partial tiles in its tile row and tile column, and the part of
+ * its own tile, each kept in its own table. A change inside a box only
+ * recomputes the local integrals of the tiles it touches and the prefix sums
+ * across their tile row and column, O(tile area + tile size * number of tiles
+ * per row or column) per tile instead of the whole image.
+ */
+class TiledIntegral
+{
+public:
+  TiledIntegral() = default;
+  explicit TiledIntegral(const cv::Mat& values, int tile_shift = 6);
+
+  bool empty() const
+  {
+    return m_local.empty();
+  }
+
+  cv::Size size() const
+  {
+    return m_size;
+  }
+
+  /*
+   * Sum over [0, x) x [0, y), for 0 <= x <= cols and 0 <= y <= rows, from four
+   * lookups.
+   */
+  int operator()(int x, int y) const
+  {
+    const int tx = x >> m_tile_shift;
+    const int ty = y >> m_tile_shift;
+    return m_tiles.ptr<int>(ty)[tx] + m_rows.ptr<int>(y)[tx] + m_cols.ptr<int>(ty)[x] + m_local.ptr<int>(y)[x];
+  }
+
+  int sum(cv::Rect rect) const
+  {
+    return (*this)(rect.x + rect.width, rect.y + rect.height) - (*this)(rect.x, rect.y + rect.height) - (*this)(rect.x + rect.width, rect.y) + (*this)(rect.x, rect.y);
+  }
+
+  /*
+   * Smallest union of whole tiles containing box, clipped to the image.
+   */
+  cv::Rect tiles(cv::Rect box) const;
+
+  /*
+   * Replaces the values inside tiles, which has to be returned by tiles().
+   * values are the new values of that rectangle.
+   */
+  void update(cv::Rect tiles, const cv::Mat& values);
+
+  // Deep copy, the tables are shared between copies otherwise.
+  TiledIntegral clone() const;
+
+private:
+  void update_tile(int tx, int ty, const cv::Mat& values);
+
+  int m_tile_shift = 6;
+  cv::Size m_size;
+
+  // Per tile: integral of the tile itself, of its rows over the full tile width, of its columns over the full tile height, and its sum.
+  cv::Mat m_local;
+  cv::Mat m_tile_rows;
+  cv::Mat m_tile_cols;
+  cv::Mat m_counts;
+
+  // Prefix sums over whole tiles: of the tile sums, across a tile row and down a tile column.
+  cv::Mat m_tiles;
+  cv::Mat m_rows;
+  cv::Mat m_cols;
+};
+
+#endif /* TRLIB_TILED_INTEGRAL_HPP_ */
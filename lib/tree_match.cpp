@@ -30,6 +30,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <functional>
 #include <numeric>
 #include <set>
+#include <utility>
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -43,13 +44,17 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "affine_transformation.hpp"
 #include "bezier_ransac.hpp"
 #include "convex_hull.hpp"
+#include "feature_cache.hpp"
 #include "generate_patches.hpp"
 #include "histogram.hpp"
 #include "line_segment_detect.hpp"
+#include "memory_budget.hpp"
 //#include "match.hpp"
 #include "opencv_extra.hpp"
 #include "texture.hpp"
+#include "thread_pool.hpp"
 #include "timer.hpp"
+#include "validity_cache.hpp"
 
 namespace fs = boost::filesystem;
 namespace pt = boost::property_tree;
@@ -66,6 +71,8 @@ m_filter_bank(filter_resolution, frequency_octaves, num_filter_directions)
     m_patch_sizes.emplace_back(current_patch_size);
     current_patch_size = 2 * current_patch_size - boundary_size;
   }
+
+  set_options(MatchingOptions());
 }
 
 void TreeMatch::add_target(const boost::filesystem::path& path, double dpi, double scale)
@@ -127,51 +134,144 @@ void TreeMatch::compute_responses(double weight_intensity, double weight_sobel,
     return;
   }
 
-  std::cout << "Compute target responses..." << std::endl;
-  for (Texture& target : m_targets)
+  m_cpu_matcher.clear_caches();
+  m_cpu_matcher.set_orientations(weight_gabor > 0.0 ? m_filter_bank.num_frequencies() : 0, m_filter_bank.num_directions());
+
+  const MatchingOptions& options = m_cpu_matcher.options();
+  FeatureCache feature_cache(options.feature_cache_dir);
+
+  std::vector<Texture> textures_histogram;
+  if (histogram_matching_factor != 0.0)
   {
-    if (histogram_matching_factor != 0.0)
-    {
-      std::vector<Texture> textures_histogram;
-      for (const std::vector<Texture>& textures : m_textures)
-      {
-        textures_histogram.push_back(textures.front());
-      }
-      target.response = evaluator.evaluate_with_histogram_matching(target.texture, textures_histogram, target.mask_rotation, histogram_matching_factor);
-    }
-    else
+    for (const std::vector<Texture>& textures : m_textures)
     {
-      target.response = evaluator.evaluate(target.texture, target.mask());
+      textures_histogram.push_back(textures.front());
     }
-
-    cv::erode(target.mask_rotation, target.mask_rotation, kernel, cv::Point(-1, -1), 1, cv::BORDER_CONSTANT, cv::Scalar(0));
   }
-  std::cout << "done" << std::endl;
 
-  int num_textures = 0;
-  for (std::vector<Texture>& textures_rot : m_textures)
+  struct ResponseTask
   {
-    num_textures += static_cast<int>(textures_rot.size());
-  }
+    Texture* texture;
+    const Texture* source;
+    bool is_target;
+    bool evaluate;
+    bool use_cache;
+    uint64_t cache_key;
+  };
 
-  int i = 0;
-  std::cout << "Compute " << num_textures << " texture features..." << std::endl;
+  /*
+   * Targets and textures are independent tasks. Rotated textures with derived
+   * features depend on their unrotated texture and run in a second round.
+   * With kernel rotation, only the unrotated texture needs features.
+   */
+  std::vector<ResponseTask> tasks;
+  std::vector<ResponseTask> tasks_derived;
+  for (Texture& target : m_targets)
+  {
+    tasks.push_back(ResponseTask{&target, nullptr, true, true, false, 0});
+  }
   for (std::vector<Texture>& textures_rot : m_textures)
   {
+    // Keys are computed before any mask is eroded.
+    const uint64_t source_key = feature_cache.enabled() ? FeatureCache::source_key(evaluator, textures_rot.front()) : 0;
     for (Texture& t : textures_rot)
     {
-      i++;
-      if ((i % 10) == 0)
+      if (options.derive_rotated_features && !options.rotate_kernel && &t != &textures_rot.front())
+      {
+        const uint64_t cache_key = feature_cache.enabled() ? FeatureCache::rotation_key(source_key, t, true) : 0;
+        tasks_derived.push_back(ResponseTask{&t, &textures_rot.front(), false, true, feature_cache.enabled(), cache_key});
+      }
+      else
+      {
+        const bool evaluate = !options.rotate_kernel || &t == &textures_rot.front();
+        const uint64_t cache_key = feature_cache.enabled() ? FeatureCache::rotation_key(source_key, t, false) : 0;
+        tasks.push_back(ResponseTask{&t, nullptr, false, evaluate, evaluate && feature_cache.enabled(), cache_key});
+      }
+    }
+  }
+
+  // Every task reserves an estimate of its working memory, which bounds the number of tasks running at once.
+  MemoryBudget budget(options.feature_memory_budget_mb * 1024.0 * 1024.0);
+  int num_done = 0;
+  int num_cached = 0;
+  auto run_tasks = [&](const std::vector<ResponseTask>& round)
+  {
+    // A round with fewer tasks than threads runs serially, so OpenCV and the loops inside each task get the whole pool.
+    const bool parallel = static_cast<int>(round.size()) >= ThreadPool::num_threads();
+    ThreadPool::ParallelScope parallel_scope(parallel);
+    #pragma omp parallel for schedule(dynamic) if(parallel)
+    for (int i = 0; i < static_cast<int>(round.size()); ++i)
+    {
+      const ResponseTask& task = round[i];
+      Texture& t = *task.texture;
+      if (task.use_cache && feature_cache.load(task.cache_key, t))
+      {
+        t.mask_used_integral = TiledIntegral();
+        #pragma omp critical(trlib_compute_responses_progress)
+        {
+          ++num_cached;
+          if ((++num_done % 10) == 0)
+          {
+            std::cout << "(" << num_done << ")" << std::flush;
+          }
+          std::cout << "c" << std::flush;
+        }
+        continue;
+      }
+
+      double bytes = 0.0;
+      if (task.source)
+      {
+        bytes = 2.0 * task.source->response.num_channels() * t.texture.total() * sizeof(uint16_t);
+      }
+      else if (task.evaluate)
+      {
+        bytes = evaluator.working_set_bytes(t.texture.size());
+      }
+
       {
-        std::cout << "(" << i << ")" << std::flush;
+        MemoryBudget::Reservation reservation(budget, bytes);
+        if (task.source)
+        {
+          t.response = evaluator.rotate_response(task.source->response, t.transformation_matrix, t.texture.size());
+        }
+        else if (task.evaluate && task.is_target && histogram_matching_factor != 0.0)
+        {
+          t.response = evaluator.evaluate_with_histogram_matching(t.texture, textures_histogram, t.mask_rotation, histogram_matching_factor);
+        }
+        else if (task.evaluate)
+        {
+          t.response = evaluator.evaluate(t.texture, t.mask());
+        }
       }
-      std::cout << "." << std::flush;
 
-      t.response = evaluator.evaluate(t.texture, t.mask());
       cv::erode(t.mask_rotation, t.mask_rotation, kernel, cv::Point(-1, -1), 1, cv::BORDER_CONSTANT, cv::Scalar(0));
+      if (!task.is_target)
+      {
+        t.mask_used_integral = TiledIntegral();
+      }
+      if (task.use_cache)
+      {
+        feature_cache.store(task.cache_key, t);
+      }
+
+      #pragma omp critical(trlib_compute_responses_progress)
+      {
+        if ((++num_done % 10) == 0)
+        {
+          std::cout << "(" << num_done << ")" << std::flush;
+        }
+        std::cout << "." << std::flush;
+      }
     }
-  }
-  std::cout << "done" << std::endl;
+  };
+
+  std::cout << "Compute " << m_targets.size() << " target and " << tasks.size() + tasks_derived.size() - m_targets.size() << " texture features..." << std::endl;
+  run_tasks(tasks);
+  run_tasks(tasks_derived);
+  std::cout << "done (" << num_cached << " from cache, peak working memory " << budget.peak_bytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+
+  m_cpu_matcher.prepare(m_targets, m_textures);
 }
 
 static bool is_valid_point(cv::Point p, cv::Mat mask)
@@ -199,7 +299,7 @@ cv::Mat TreeMatch::fit_single_patch(const boost::filesystem::path& filename)
 {
   if (m_textures.empty())
   {
-    throw(std::invalid_argument("TreeMatch::match_patch_impl called but no textures supplied."));
+    throw(std::invalid_argument("TreeMatch::fit_single_patch called but no textures supplied."));
   }
 
   FeatureEvaluator evaluator(0.5, 0.5, 0.0, m_filter_bank);
@@ -232,14 +332,13 @@ cv::Mat TreeMatch::fit_single_patch(const boost::filesystem::path& filename)
     }
   }
 
+  ThreadPool::ParallelScope parallel_scope;
 #pragma omp parallel for
   for (int i = 0; i < static_cast<int>(results.size()); ++i)
   {
-    cv::Mat texture_mask;
-    cv::erode(m_textures[results[i].texture_index][results[i].texture_rot].mask(), texture_mask, patch.mask(), cv::Point(0, 0), 1, cv::BORDER_CONSTANT, 0);
-    texture_mask = texture_mask(cv::Rect(0, 0, texture_mask.cols - patch.response.cols() + 1, texture_mask.rows - patch.response.rows() + 1));
+    cv::Mat texture_mask = valid_positions(m_textures[results[i].texture_index][results[i].texture_rot].mask(), patch.mask(), patch.response.size());
 
-    if (cv::countNonZero(texture_mask) > 0)
+    if (cv::countNonZero(texture_mask) > 0 && m_textures[results[i].texture_index][results[i].texture_rot].response.num_channels() > 0)
     {
       cv::Mat match = m_textures[results[i].texture_index][results[i].texture_rot].template_match(patch);
       cv::minMaxLoc(match, &results[i].cost, 0, &results[i].texture_pos, 0, texture_mask);
@@ -266,6 +365,7 @@ bool TreeMatch::find_next_patch()
     return false;
   }
   
+  schedule_regions();
   const PatchRegion region = m_reconstruction_regions.front();
   m_reconstruction_regions.pop_front();
  
@@ -294,6 +394,7 @@ bool TreeMatch::find_next_patch_adaptive()
     return false;
   }
 
+  schedule_regions();
   const PatchRegion region = m_reconstruction_regions.front();
   m_reconstruction_regions.pop_front();
 
@@ -336,6 +437,7 @@ bool TreeMatch::find_next_patch_adaptive()
 
       const int level_fine = patch_coarse.level - 1;
       std::vector<AdaptivePatch> patches_fine;
+      std::vector<PatchRegion> regions_fine;
       cv::Size patch_size_fine = m_patch_sizes[level_fine];
       for (int y = 0; y < 2; ++y)
       {
@@ -344,19 +446,56 @@ bool TreeMatch::find_next_patch_adaptive()
           int x_fine = patch_coarse.patches[0].anchor_target().x + x * (patch_size_fine.width - m_subpatch_size.width);
           int y_fine = patch_coarse.patches[0].anchor_target().y + y * (patch_size_fine.height - m_subpatch_size.height);
           cv::Rect region_fine(cv::Point(x_fine, y_fine), patch_size_fine);
-          
-          AdaptivePatch patch_fine(match_patch(PatchRegion(patch_coarse.target_index(), patch_coarse.coordinate(), region_fine)), level_fine);
+          regions_fine.push_back(PatchRegion(patch_coarse.target_index(), patch_coarse.coordinate(), region_fine));
+        }
+      }
 
-          if (patch_fine.cost() == std::numeric_limits<double>::max())
-          {
-            return false;
-          }
+      // Local refinement searches around the source area of the parent patch first (not with rotated kernels).
+      const bool use_local = options().local_refinement_radius > 0 && !options().rotate_kernel && patch_coarse.patches.size() == 1;
 
-          patches_fine.push_back(patch_fine);
-          mask_patch_resources(patch_fine);
-          cost_fine += patch_fine.cost();
-          num_pixels_fine += patch_fine.num_pixels();
+      /*
+       * With speculative matching, the finer regions are searched concurrently
+       * against the same mask state and placed in order. A region whose match
+       * overlaps material taken by an earlier one is searched again.
+       */
+      std::vector<MatchCandidate> matches_fine;
+      if (options().speculative_matching && m_cpu_matcher.matches_reusable() && !use_local)
+      {
+        std::vector<const PatchRegion*> regions;
+        for (const PatchRegion& r : regions_fine)
+        {
+          regions.push_back(&r);
         }
+        matches_fine = m_cpu_matcher.search_speculative(regions, m_targets, m_textures, m_matching_statistics);
+        m_matching_statistics.num_fine_searches += regions.size();
+      }
+
+      for (size_t i = 0; i < regions_fine.size(); ++i)
+      {
+        std::vector<Patch> patches;
+        if (use_local)
+        {
+          patches.push_back(match_patch_local(regions_fine[i], patch_coarse.patches[0]));
+        }
+        else if (!matches_fine.empty())
+        {
+          patches.push_back(place_speculative_match(regions_fine[i], matches_fine[i]));
+        }
+        else
+        {
+          patches = match_patch(regions_fine[i]);
+        }
+        AdaptivePatch patch_fine(patches, level_fine);
+
+        if (patch_fine.cost() == std::numeric_limits<double>::max())
+        {
+          return false;
+        }
+
+        patches_fine.push_back(patch_fine);
+        mask_patch_resources(patch_fine);
+        cost_fine += patch_fine.cost();
+        num_pixels_fine += patch_fine.num_pixels();
       }
 
       /*
@@ -387,76 +526,85 @@ bool TreeMatch::find_next_patch_adaptive()
   return true;
 }
 
-Patch TreeMatch::match_patch_impl(const PatchRegion& region, cv::Mat mask)
+Patch TreeMatch::place_speculative_match(const PatchRegion& region, const MatchCandidate& match)
 {
-  if (m_textures.empty())
+  if (match.cost < std::numeric_limits<double>::max() && m_cpu_matcher.candidate_available(match, region, m_textures))
   {
-    throw(std::invalid_argument("TreeMatch::match_patch_impl called but no textures supplied."));
+    return place_match_candidate(region, match);
   }
 
-  struct MatchPatchResult
-  {
-    MatchPatchResult(int texture_index, int texture_rot) :
-      texture_index(texture_index),
-      texture_rot(texture_rot),
-      cost(std::numeric_limits<double>::max()),
-      texture_pos(-1, -1)
-    {}
+  // An earlier region took the material, search again against the current state.
+  ++m_matching_statistics.num_fine_rematches;
+  return match_patch_impl(region, region.mask());
+}
 
-    int texture_index;
-    int texture_rot;
-    double cost;
-    cv::Point texture_pos;
-    cv::Mat error;
-  };
+Patch TreeMatch::match_patch_local(const PatchRegion& region, const Patch& parent)
+{
+  const MatchCandidate local = m_cpu_matcher.search_local(region, parent, m_targets, m_textures);
+  const double parent_cost = parent.cost() / parent.size().area();
+  if (local.cost < std::numeric_limits<double>::max() && local.cost / region.bounding_box().area() <= options().local_refinement_threshold * parent_cost)
+  {
+    ++m_matching_statistics.num_local_matches;
+    return place_match_candidate(region, local);
+  }
 
-  const bool is_rectangular = (mask.empty() || cv::countNonZero(mask) == mask.rows*mask.cols);
- 
+  ++m_matching_statistics.num_local_fallbacks;
+  return match_patch_impl(region, region.mask());
+}
 
-  Texture kernel = m_targets[region.target_index()](region.bounding_box());
+void TreeMatch::schedule_regions()
+{
+  const MatchingOptions& options = m_cpu_matcher.options();
+  if (options.region_lookahead == 0 || m_textures.empty() || m_reconstruction_regions.empty() || m_cpu_matcher.scheduled(m_reconstruction_regions.front()) || !m_cpu_matcher.matches_reusable())
+  {
+    return;
+  }
 
-  std::vector<MatchPatchResult> results;
-  for (size_t i = 0; i < m_textures.size(); ++i)
+  std::vector<const PatchRegion*> regions;
+  const size_t num_regions = std::min(m_reconstruction_regions.size(), static_cast<size_t>(options.region_lookahead));
+  for (size_t i = 0; i < num_regions; ++i)
   {
-    for (size_t j = 0; j < m_textures[i].size(); ++j)
+    const PatchRegion& region = m_reconstruction_regions[i];
+    if (!region.has_sub_regions() && !m_cpu_matcher.scheduled(region))
     {
-      results.emplace_back(static_cast<int>(i), static_cast<int>(j));
+      regions.push_back(&region);
     }
   }
-   
-  #pragma omp parallel for
-  for (int i = 0; i < static_cast<int>(results.size()); ++i)
-  {
-    cv::Mat texture_mask;
-    cv::erode(m_textures[results[i].texture_index][results[i].texture_rot].mask(), texture_mask, region.mask(), cv::Point(0, 0), 1, cv::BORDER_CONSTANT, 0);
-    texture_mask = texture_mask(cv::Rect(0, 0, texture_mask.cols - kernel.response.cols() + 1, texture_mask.rows - kernel.response.rows() + 1));
 
-    if (cv::countNonZero(texture_mask) > 0)
+  // Search the regions concurrently against the current state; match_patch_impl validates the candidates when their region comes up.
+  std::vector<std::vector<MatchCandidate>> candidates;
+  m_cpu_matcher.search_speculative(regions, m_targets, m_textures, m_matching_statistics, &candidates);
+
+  for (size_t i = 0; i < regions.size(); ++i)
+  {
+    ++m_matching_statistics.num_scheduled_searches;
+    if (!candidates[i].empty())
     {
-      cv::Mat match;
-      if (is_rectangular)
-      {
-        match = m_textures[results[i].texture_index][results[i].texture_rot].template_match(kernel);
-      }
-      else
-      {
-        match = m_textures[results[i].texture_index][results[i].texture_rot].template_match(kernel, region.mask());
-      }
-      cv::minMaxLoc(match, &results[i].cost, 0, &results[i].texture_pos, 0, texture_mask);
+      m_cpu_matcher.schedule(*regions[i], std::move(candidates[i]));
     }
   }
+}
 
-  MatchPatchResult result_min = *std::min_element(results.begin(), results.end(), [](const MatchPatchResult& lhs, const MatchPatchResult& rhs){return lhs.cost < rhs.cost; });
-
-
-  if (result_min.cost == std::numeric_limits<double>::max())
+Patch TreeMatch::match_patch_impl(const PatchRegion& region, cv::Mat mask)
+{
+  MatchCandidate match;
+  if (!m_cpu_matcher.find_stored_match(region, m_textures, match, m_matching_statistics))
   {
-    std::cout << "Finished. No more texture samples available." << std::endl;
+    match = m_cpu_matcher.search(region, mask, m_targets, m_textures, m_matching_statistics);
   }
+  return place_match_candidate(region, match);
+}
 
-  const cv::Mat error_mat = m_targets[region.target_index()].response(region.bounding_box()).dist_sqr_mat(m_textures[result_min.texture_index][result_min.texture_rot].response(cv::Rect(result_min.texture_pos, region.bounding_box().size())));
-
-  Patch patch(region, result_min.texture_pos, m_textures[result_min.texture_index][result_min.texture_rot].transformation_matrix, result_min.texture_index, result_min.texture_rot, error_mat, result_min.cost);
+Patch TreeMatch::place_match_candidate(const PatchRegion& region, const MatchCandidate& candidate)
+{
+  const Texture& texture = m_textures[candidate.texture_index][candidate.texture_rot];
+  const cv::Rect window(candidate.texture_pos, region.bounding_box().size());
+  const FeatureVector texture_response = options().rotate_kernel ?
+    m_cpu_matcher.rotated_response_window(m_textures[candidate.texture_index], candidate.texture_rot, window) :
+    texture.response(window);
+  const cv::Mat error_mat = m_targets[region.target_index()].response(region.bounding_box()).dist_sqr_mat(texture_response);
+
+  Patch patch(region, candidate.texture_pos, texture.transformation_matrix, candidate.texture_index, candidate.texture_rot, error_mat, candidate.cost);
   add_patch(patch);
 
   return patch;
@@ -684,38 +832,9 @@ void TreeMatch::mask_patch_resources(const AdaptivePatch& adaptive_patch)
 
 void TreeMatch::mask_patch_resources(const Patch& patch, const cv::Mat& mask)
 {
-  const Texture& texture_source = m_textures[patch.source_index][patch.source_rot];
-  cv::Mat mask_texture_new = cv::Mat::ones(texture_source.mask_done.size(), CV_8UC1);
-
-  if (mask.empty())
-  {
-    mask_texture_new(cv::Rect(patch.anchor_source, patch.size())) = 0;
-  }
-  else
-  {
-#pragma omp parallel for
-    for (int y = 0; y < mask.rows; ++y)
-    {
-      unsigned char* ptr_mask_new = reinterpret_cast<unsigned char*>(mask_texture_new.ptr(patch.anchor_source.y+y));
-      const unsigned char* ptr_mask = reinterpret_cast<const unsigned char*>(mask.ptr(y));
-      for (int x = 0; x < mask.cols; ++x)
-      {
-        if (ptr_mask[x])
-        {
-          ptr_mask_new[patch.anchor_source.x+x] = 0;
-        }
-      }
-    }
-  }
-
-  for (size_t i = 0; i < m_textures[patch.source_index].size(); ++i)
-  {
-    cv::Mat transform_mask = AffineTransformation::concat(m_textures[patch.source_index][i].transformation_matrix, texture_source.transformation_matrix_inv);
-    cv::Mat mask_rotated;
-    cv::warpAffine(mask_texture_new, mask_rotated, transform_mask, m_textures[patch.source_index][i].mask_done.size(), cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(1));
-    cv::erode(mask_rotated, mask_rotated, cv::Mat::ones(3, 3, CV_8UC1));
-    m_textures[patch.source_index][i].mask_done = cv::min(m_textures[patch.source_index][i].mask_done, mask_rotated);
-  }
+  const cv::Rect rect(patch.anchor_source, mask.empty() ? patch.size() : mask.size());
+  const std::vector<cv::Rect> boxes = Texture::update_mask_done(m_textures[patch.source_index], patch.source_rot, rect, mask, true);
+  m_cpu_matcher.patch_placed(patch, rect.size(), boxes);
 }
 
 void TreeMatch::unmask_patch_resources(const Patch& patch)
@@ -733,39 +852,9 @@ void TreeMatch::unmask_patch_resources(const AdaptivePatch& adaptive_patch)
 
 void TreeMatch::unmask_patch_resources(const Patch& patch, const cv::Mat& mask)
 {
-  const Texture& texture_source = m_textures[patch.source_index][patch.source_rot];
-  cv::Mat mask_texture_new = cv::Mat::ones(texture_source.mask_done.size(), CV_8UC1);
-
-  if (mask.empty())
-  {
-    mask_texture_new(cv::Rect(patch.anchor_source, patch.size())) = 0;
-  }
-  else
-  {
-#pragma omp parallel for
-    for (int y = 0; y < mask.rows; ++y)
-    {
-      unsigned char* ptr_mask_new = reinterpret_cast<unsigned char*>(mask_texture_new.ptr(patch.anchor_source.y+y));
-      const unsigned char* ptr_mask = reinterpret_cast<const unsigned char*>(mask.ptr(y));
-      for (int x = 0; x < mask.cols; ++x)
-      {
-        if (ptr_mask[x])
-        {
-          ptr_mask_new[patch.anchor_source.x+x] = 0;
-        }
-      }
-    }
-  }
-
-  for (size_t i = 0; i < m_textures[patch.source_index].size(); ++i)
-  {
-    cv::Mat transform_mask = AffineTransformation::concat(m_textures[patch.source_index][i].transformation_matrix, texture_source.transformation_matrix_inv);
-    cv::Mat mask_rotated;
-    cv::warpAffine(mask_texture_new, mask_rotated, transform_mask, m_textures[patch.source_index][i].mask_done.size(), cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(1));
-    cv::erode(mask_rotated, mask_rotated, cv::Mat::ones(3, 3, CV_8UC1));
-    mask_rotated = 1 - mask_rotated;
-    m_textures[patch.source_index][i].mask_done = cv::max(m_textures[patch.source_index][i].mask_done, mask_rotated);
-  }
+  const cv::Rect rect(patch.anchor_source, mask.empty() ? patch.size() : mask.size());
+  const std::vector<cv::Rect> boxes = Texture::update_mask_done(m_textures[patch.source_index], patch.source_rot, rect, mask, false);
+  m_matching_statistics.num_scheduled_invalidations += m_cpu_matcher.patch_released(patch, rect.size(), boxes);
 }
 
 void TreeMatch::add_patch(const Patch& patch)
@@ -1020,6 +1109,8 @@ void TreeMatch::downsample(int factor)
   std::for_each(
     m_reconstruction_regions.begin(), m_reconstruction_regions.end(),
     std::bind(&PatchRegion::scale, std::placeholders::_1, 1.0/factor));
+
+  m_cpu_matcher.clear();
 }
 
 static int get_index(std::vector<std::string>& filenames, std::string filename)
@@ -1254,6 +1345,7 @@ TreeMatch TreeMatch::load(const boost::filesystem::path& path, bool load_texture
   int num_filter_directions;
   double filter_bandwidth_octaves;
   bool sort_patches_saliency;
+  MatchingOptions options;
 
   try
   {
@@ -1388,6 +1480,7 @@ TreeMatch TreeMatch::load(const boost::filesystem::path& path, bool load_texture
     num_filter_directions = root.get<int>("num_filter_directions");
     filter_bandwidth_octaves = root.get<double>("filter_bandwidth_octaves");
     sort_patches_saliency = root.get<bool>("sort_patches_saliency");
+    options = MatchingOptions::load(root, path_json);
 
     if (min_patch_size % 8 != 0)
     {
@@ -1423,7 +1516,8 @@ TreeMatch TreeMatch::load(const boost::filesystem::path& path, bool load_texture
       << "histogram_matching: " << histogram_matching << std::endl
       << "filter_resolution: " << filter_resolution << std::endl
       << "num_filter_directions: " << num_filter_directions << std::endl
-      << "filter_bandwidth_octaves: " << filter_bandwidth_octaves << std::endl;
+      << "filter_bandwidth_octaves: " << filter_bandwidth_octaves << std::endl
+      << options;
 
     if (root.count("downsample"))
     {
@@ -1440,6 +1534,7 @@ TreeMatch TreeMatch::load(const boost::filesystem::path& path, bool load_texture
   }
 
   TreeMatch matcher(min_patch_size, patch_levels, patch_quality_factor, filter_resolution, filter_bandwidth_octaves, num_filter_directions);
+  matcher.set_options(options);
 
   for (const target_json_t& t : targets_json)
   {
@@ -30,11 +30,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <opencv2/opencv.hpp>
 
 #include "adaptive_patch.hpp"
+#include "cpu_matcher.hpp"
 #include "feature_evaluator.hpp"
 #include "gabor_filter_bank.hpp"
 #include "grid.hpp"
+#include "match_candidates.hpp"
 //#include "match.hpp"
+#include "matching_options.hpp"
 #include "patch.hpp"
+#include "placement_index.hpp"
 #include "texture.hpp"
 
 class TreeMatch
@@ -54,6 +58,30 @@ public:
 
   void compute_responses(double weight_intensity, double weight_sobel, double weight_gabor, double histogram_matching_factor);
 
+  /*
+   * Feature and matching settings, see MatchingOptions. The feature settings
+   * have to be set before compute_responses.
+   */
+  void set_options(const MatchingOptions& options)
+  {
+    m_cpu_matcher.set_options(options, m_patch_sizes.back(), m_subpatch_size);
+  }
+
+  const MatchingOptions& options() const
+  {
+    return m_cpu_matcher.options();
+  }
+
+  const MatchingStatistics& matching_statistics() const
+  {
+    return m_matching_statistics;
+  }
+
+  const PlacementIndex& placement_index() const
+  {
+    return m_cpu_matcher.placement_index();
+  }
+
   bool find_next_patch();
   bool find_next_patch_adaptive();
 
@@ -130,6 +158,10 @@ private:
  
   std::vector<Patch> match_patch(const PatchRegion& region);
   Patch match_patch_impl(const PatchRegion& region, cv::Mat mask);
+  void schedule_regions();
+  Patch place_speculative_match(const PatchRegion& region, const MatchCandidate& match);
+  Patch match_patch_local(const PatchRegion& region, const Patch& parent);
+  Patch place_match_candidate(const PatchRegion& region, const MatchCandidate& candidate);
 
   static cv::Mat compute_priority_map(const cv::Mat& texture);
 
@@ -146,6 +178,9 @@ private:
 
   GaborFilterBank m_filter_bank;
   std::vector<Patch> m_patches;
+
+  CPUMatcher m_cpu_matcher;
+  MatchingStatistics m_matching_statistics;
 };
 
 #endif /* TRLIB_TREE_MATCH_HPP_ */
\ No newline at end of file
@@ -34,10 +34,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #endif
 
 #include "adaptive_patch.hpp"
+#include "cpu_matcher.hpp"
 #include "feature_evaluator.hpp"
 #include "gabor_filter_bank.hpp"
 #include "grid.hpp"
+#include "match_candidates.hpp"
+#include "matching_options.hpp"
 #include "patch.hpp"
+#include "placement_index.hpp"
 #include "texture.hpp"
 
 /**
@@ -86,6 +90,31 @@ public:
 
 	void compute_responses(double weight_intensity, double weight_sobel, double weight_gabor, double histogram_matching_factor);
 
+	// Feature and matching settings, see MatchingOptions. The feature settings have to be set before compute_responses.
+	void set_options(const MatchingOptions& options)
+	{
+		m_cpu_matcher.set_options(options, m_patch_sizes.back(), m_subpatch_size);
+#ifdef TRLIB_TREE_MATCH_USE_OPENCL
+		m_cl_matcher.get_policy<ocl_patch_matching::matching_policies::CLMatcher>().set_num_matches(static_cast<std::size_t>(m_cpu_matcher.options().num_match_candidates), m_cpu_matcher.options().match_candidate_nms_radius);
+#endif
+	}
+
+	const MatchingOptions& options() const
+	{
+		return m_cpu_matcher.options();
+	}
+
+	const MatchingStatistics& matching_statistics() const
+	{
+		return m_matching_statistics;
+	}
+
+	// Source areas of placed patches and held patches of adaptive matching, queryable in any rotation frame.
+	const PlacementIndex& placement_index() const
+	{
+		return m_cpu_matcher.placement_index();
+	}
+
 	bool find_next_patch();
 	bool find_next_patch_adaptive();
 
@@ -162,6 +191,12 @@ private:
 
 	std::vector<Patch> match_patch(const PatchRegion& region);
 	Patch match_patch_impl(const PatchRegion& region, cv::Mat mask);
+	MatchCandidate search_match(const PatchRegion& region, cv::Mat mask, std::vector<MatchCandidate>* candidates = nullptr);
+	void schedule_regions();
+	std::vector<MatchCandidate> search_matches_speculative(const std::vector<const PatchRegion*>& regions, std::vector<std::vector<MatchCandidate>>* candidates = nullptr);
+	Patch place_speculative_match(const PatchRegion& region, const MatchCandidate& match);
+	Patch match_patch_local(const PatchRegion& region, const Patch& parent);
+	Patch place_match_candidate(const PatchRegion& region, const MatchCandidate& candidate);
 
 	static cv::Mat compute_priority_map(const cv::Mat& texture);
 
@@ -179,6 +214,9 @@ private:
 	GaborFilterBank m_filter_bank;
 	std::vector<Patch> m_patches;
 
+	CPUMatcher m_cpu_matcher;
+	MatchingStatistics m_matching_statistics;
+
 	// OpenCL Matcher
 #ifdef TRLIB_TREE_MATCH_USE_OPENCL
 	ocl_patch_matching::Matcher m_cl_matcher;
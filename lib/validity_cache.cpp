@@ -0,0 +1,175 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "validity_cache.hpp"
+
+#include <climits>
+
+#include "bit_mask.hpp"
+#include "match_candidates.hpp"
+
+cv::Mat valid_positions(const cv::Mat& texture_mask, const cv::Mat& kernel_mask, cv::Size kernel_size)
+{
+  const cv::Size size(texture_mask.cols - kernel_size.width + 1, texture_mask.rows - kernel_size.height + 1);
+  if (size.width <= 0 || size.height <= 0)
+  {
+    return cv::Mat();
+  }
+
+  const BitMask texture_bits(texture_mask);
+  const BitMask valid = kernel_mask.empty() ? texture_bits.erode(kernel_size.width, kernel_size.height) : texture_bits.erode(RowRunMask(kernel_mask));
+  return valid.to_mat(cv::Rect(cv::Point(0, 0), size));
+}
+
+static cv::Mat texture_mask(const Texture& texture, cv::Rect rect)
+{
+  return cv::min(texture.mask_done(rect), texture.mask_rotation(rect));
+}
+
+void ValidityMap::compute(const Texture& texture, const cv::Mat& kernel_mask)
+{
+  m_valid = valid_positions(texture.mask(), kernel_mask, kernel_mask.size());
+  m_num_valid = cv::countNonZero(m_valid);
+}
+
+cv::Mat ValidityMap::update(const Texture& texture, const cv::Mat& kernel_mask, MatchingStatistics* stats)
+{
+  if (kernel_mask.cols > texture.mask_done.cols || kernel_mask.rows > texture.mask_done.rows)
+  {
+    m_num_valid = 0;
+    return cv::Mat();
+  }
+
+  if (m_valid.empty())
+  {
+    compute(texture, kernel_mask);
+    m_dirty.clear();
+    if (stats)
+    {
+      ++stats->num_validity_computed;
+    }
+    return m_valid;
+  }
+
+  // Positions whose kernel window overlaps a dirty rectangle.
+  const cv::Rect positions(cv::Point(0, 0), m_valid.size());
+  std::vector<cv::Rect> affected;
+  double affected_area = 0.0;
+  for (const cv::Rect& rect : m_dirty)
+  {
+    const cv::Rect a = cv::Rect(rect.x - kernel_mask.cols + 1, rect.y - kernel_mask.rows + 1, rect.width + kernel_mask.cols - 1, rect.height + kernel_mask.rows - 1) & positions;
+    if (a.area() > 0)
+    {
+      affected.push_back(a);
+      affected_area += a.area();
+    }
+  }
+  m_dirty.clear();
+
+  // Many scattered updates are cheaper as one erosion of the full mask.
+  if (affected_area >= 0.5 * positions.area())
+  {
+    compute(texture, kernel_mask);
+    if (stats)
+    {
+      ++stats->num_validity_computed;
+    }
+    return m_valid;
+  }
+
+  if (stats)
+  {
+    ++stats->num_validity_reused;
+  }
+
+  for (const cv::Rect& a : affected)
+  {
+    // The windows of the affected positions lie inside the texture.
+    const cv::Rect source(a.x, a.y, a.width + kernel_mask.cols - 1, a.height + kernel_mask.rows - 1);
+    const cv::Mat eroded = valid_positions(texture_mask(texture, source), kernel_mask, kernel_mask.size());
+
+    cv::Mat valid_a = m_valid(a);
+    m_num_valid -= cv::countNonZero(valid_a);
+    eroded.copyTo(valid_a);
+    m_num_valid += cv::countNonZero(valid_a);
+  }
+
+  return m_valid;
+}
+
+void ValidityMap::invalidate(cv::Rect rect)
+{
+  const size_t max_dirty_rects = 8;
+  if (m_valid.empty())
+  {
+    return;
+  }
+
+  if (m_dirty.size() < max_dirty_rects)
+  {
+    m_dirty.push_back(rect);
+    return;
+  }
+
+  for (const cv::Rect& r : m_dirty)
+  {
+    rect |= r;
+  }
+  m_dirty.assign(1, rect);
+}
+
+ValidityMap* ValidityCache::find(int texture_index, int texture_rot, const Texture& texture, const cv::Mat& kernel_mask)
+{
+  const Key key(texture_index, texture_rot, kernel_mask.cols, kernel_mask.rows, mask_hash(kernel_mask));
+  auto it = m_maps.find(key);
+  if (it != m_maps.end())
+  {
+    return &it->second;
+  }
+
+  const double bytes = static_cast<double>(texture.mask_done.total());
+  if (m_budget_bytes >= 0.0 && m_used_bytes + bytes > m_budget_bytes)
+  {
+    return nullptr;
+  }
+
+  m_used_bytes += bytes;
+  return &m_maps[key];
+}
+
+void ValidityCache::invalidate(int texture_index, int texture_rot, cv::Rect rect)
+{
+  if (rect.area() == 0)
+  {
+    return;
+  }
+
+  // Keys are ordered by texture and rotation first.
+  for (auto it = m_maps.lower_bound(Key(texture_index, texture_rot, INT_MIN, INT_MIN, 0)); it != m_maps.end() && std::get<0>(it->first) == texture_index && std::get<1>(it->first) == texture_rot; ++it)
+  {
+    it->second.invalidate(rect);
+  }
+}
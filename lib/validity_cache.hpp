@@ -0,0 +1,117 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRLIB_VALIDITY_CACHE_HPP_
+#define TRLIB_VALIDITY_CACHE_HPP_
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "sqdiff_kernels.hpp"
+#include "texture.hpp"
+
+/*
+ * Positions of the top left kernel corner at which all pixels of kernel_mask
+ * lie on non-zero pixels of texture_mask (255 there, 0 elsewhere), of size
+ * texture - kernel_size + 1. An empty kernel_mask covers all of kernel_size.
+ * The erosion runs on bit-packed masks; the result is empty if the kernel does
+ * not fit into the texture.
+ */
+cv::Mat valid_positions(const cv::Mat& texture_mask, const cv::Mat& kernel_mask, cv::Size kernel_size);
+
+/*
+ * Positions at which a kernel mask fits into the available pixels of one
+ * texture rotation: the texture mask eroded with the kernel mask (anchored at
+ * the top left corner), cropped to the positions where the kernel lies inside
+ * the texture. After the texture mask changed inside a rectangle, only the
+ * positions whose kernel window overlaps that rectangle are recomputed.
+ */
+class ValidityMap
+{
+public:
+  /*
+   * Brings the map up to date with the mask of texture and returns it. The
+   * kernel mask must be the one the map was created for.
+   */
+  cv::Mat update(const Texture& texture, const cv::Mat& kernel_mask, MatchingStatistics* stats = nullptr);
+
+  /*
+   * Marks rect of the texture mask as changed. Beyond a few rectangles, the
+   * dirty area is kept as their bounding box, so maps that are not updated
+   * for a long time do not grow.
+   */
+  void invalidate(cv::Rect rect);
+
+  int num_valid() const
+  {
+    return m_num_valid;
+  }
+
+private:
+  void compute(const Texture& texture, const cv::Mat& kernel_mask);
+
+  cv::Mat m_valid;
+  std::vector<cv::Rect> m_dirty;
+  int m_num_valid = 0;
+};
+
+/*
+ * Validity maps per (texture, rotation, kernel mask shape). New shapes are
+ * only added while the maps fit into budget_bytes (negative: unlimited), so
+ * find may return nullptr. find and invalidate are not thread safe, but maps
+ * of different (texture, rotation) pairs may be updated concurrently.
+ */
+class ValidityCache
+{
+public:
+  explicit ValidityCache(double budget_bytes = -1.0) :
+    m_budget_bytes(budget_bytes),
+    m_used_bytes(0.0)
+  {}
+
+  ValidityMap* find(int texture_index, int texture_rot, const Texture& texture, const cv::Mat& kernel_mask);
+  void invalidate(int texture_index, int texture_rot, cv::Rect rect);
+
+  void clear()
+  {
+    m_maps.clear();
+    m_used_bytes = 0.0;
+  }
+
+  size_t size() const
+  {
+    return m_maps.size();
+  }
+
+private:
+  typedef std::tuple<int, int, int, int, uint64_t> Key;
+
+  std::map<Key, ValidityMap> m_maps;
+  double m_budget_bytes;
+  double m_used_bytes;
+};
+
+#endif /* TRLIB_VALIDITY_CACHE_HPP_ */
@@ -33,6 +33,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include "thread_pool.hpp"
 #include "tree_match_gpu.hpp"
 
 //const float pi = boost::math::constants::pi<float>();
@@ -80,7 +81,9 @@ int main(int argc, char* argv[])
 		("out,o", po::value<fs::path>(), "Output directory")
 		("vis,v", "Visualization")
 		("steps,s", po::value<fs::path>(), "Intermediate output directory")
-		("patches,p", po::value<std::vector<fs::path>>(), "Old patches for visualization");
+		("patches,p", po::value<std::vector<fs::path>>(), "Old patches for visualization")
+		("speculative", po::value<int>(), "Match this many queued regions concurrently ahead of their turn")
+		("threads,j", po::value<int>(), "Number of threads for feature computation, matching and masking (0: all)");
 
 	po::variables_map vm;
 	po::store(po::parse_command_line(argc, argv, desc, po::command_line_style::unix_style), vm);
@@ -179,8 +182,34 @@ int main(int argc, char* argv[])
 
 	std::vector<Patch> patches_old = load_patches(paths_patches);
 
+	int num_threads = 0;
+	if(vm.count("threads"))
+	{
+		num_threads = vm["threads"].as<int>();
+		if(num_threads < 0)
+		{
+			std::cerr << "Number of threads must not be negative." << std::endl;
+			return -1;
+		}
+	}
+	ThreadPool::Scope thread_pool(num_threads);
+
 	TreeMatchGPU matcher = TreeMatchGPU::load(path_in, true);
 
+	if(vm.count("speculative"))
+	{
+		const int num_regions = vm["speculative"].as<int>();
+		if(num_regions < 0)
+		{
+			std::cerr << "Number of speculative regions must not be negative." << std::endl;
+			return -1;
+		}
+		MatchingOptions options = matcher.options();
+		options.region_lookahead = num_regions;
+		options.speculative_matching = num_regions > 0;
+		matcher.set_options(options);
+	}
+
 
 	for(int i = 0; i < matcher.num_targets(); ++i)
 	{
@@ -276,6 +305,11 @@ int main(int argc, char* argv[])
 			}
 		}
 
+		if(!matcher.matching_statistics().empty())
+		{
+			std::cout << "Matching statistics: " << matcher.matching_statistics() << std::endl;
+		}
+
 		for(int i = 0; i < matcher.num_targets(); ++i)
 		{
 			matcher.save(i, path_out);
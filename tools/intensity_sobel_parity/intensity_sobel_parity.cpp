@@ -0,0 +1,178 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "intensity_sobel.hpp"
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+/*
+ * Checks compute_intensity_sobel against the cvtColor / Sobel / magnitude
+ * chain it replaced in FeatureEvaluator: intensity has to be bit-exact,
+ * Sobel may differ by one quantization step. Runs on random textures and on
+ * any images given with --in.
+ */
+
+static void reference_intensity_sobel(const cv::Mat& texture, double weight_intensity, double weight_sobel, cv::Mat& intensity, cv::Mat& sobel)
+{
+  cv::Mat texture_conv;
+  if (texture.channels() == 3)
+  {
+    cv::cvtColor(texture, texture_conv, cv::COLOR_BGR2GRAY);
+  }
+  else
+  {
+    texture_conv = texture;
+  }
+  intensity = weight_intensity * texture_conv;
+
+  cv::Mat texture_float;
+  texture_conv.convertTo(texture_float, CV_32FC1, 1.0 / 65535.0);
+
+  cv::Mat texture_sobel_x, texture_sobel_y, texture_sobel_mag;
+  cv::Sobel(texture_float, texture_sobel_x, CV_32F, 1, 0);
+  cv::Sobel(texture_float, texture_sobel_y, CV_32F, 0, 1);
+  cv::magnitude(texture_sobel_x, texture_sobel_y, texture_sobel_mag);
+  texture_sobel_mag *= 0.25;
+  texture_sobel_mag.convertTo(texture_sobel_mag, CV_16UC1, 65535.0);
+  sobel = weight_sobel * texture_sobel_mag;
+}
+
+static double max_difference(const cv::Mat& a, const cv::Mat& b)
+{
+  cv::Mat diff;
+  cv::absdiff(a, b, diff);
+  double max_val;
+  cv::minMaxLoc(diff.reshape(1), nullptr, &max_val);
+  return max_val;
+}
+
+static bool check(const std::string& name, const cv::Mat& texture)
+{
+  const double weights[][2] = {{0.5, 0.5}, {1.0, 1.0}, {3.0, 0.25}};
+
+  bool passed = true;
+  for (const auto& w : weights)
+  {
+    cv::Mat intensity, sobel, intensity_ref, sobel_ref;
+    compute_intensity_sobel(texture, w[0], w[1], intensity, sobel);
+    reference_intensity_sobel(texture, w[0], w[1], intensity_ref, sobel_ref);
+
+    const double diff_intensity = max_difference(intensity, intensity_ref);
+    const double diff_sobel = max_difference(sobel, sobel_ref);
+    const bool ok = diff_intensity == 0.0 && diff_sobel <= 1.0;
+    passed = passed && ok;
+
+    std::cout << (ok ? "ok     " : "FAILED ") << name << " " << texture.cols << "x" << texture.rows << "x" << texture.channels()
+      << ", weights " << w[0] << " / " << w[1] << ": max difference intensity " << diff_intensity << ", sobel " << diff_sobel << std::endl;
+  }
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    po::options_description desc("Allowed options");
+    desc.add_options()
+      ("help,h", "Show this help message")
+      ("in,i", po::value<std::vector<fs::path>>(), "Additional input images")
+      ("seed,s", po::value<unsigned int>()->default_value(1), "Seed of the random textures");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc, po::command_line_style::unix_style), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+      std::cout << desc << std::endl;
+      return 0;
+    }
+
+    bool passed = true;
+
+    // Odd sizes cover the scalar tails after the vector loops, single rows and columns the borders.
+    const cv::Size sizes[] = {cv::Size(1, 1), cv::Size(9, 1), cv::Size(1, 9), cv::Size(17, 5), cv::Size(64, 64), cv::Size(130, 65), cv::Size(333, 257), cv::Size(1024, 768)};
+    cv::RNG rng(vm["seed"].as<unsigned int>());
+    for (const cv::Size& size : sizes)
+    {
+      for (int type : {CV_16UC3, CV_16UC1})
+      {
+        cv::Mat texture(size, type);
+        rng.fill(texture, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(65536));
+        passed = check("random", texture) && passed;
+
+        // Smooth texture with saturated regions, closer to photographs than noise.
+        cv::GaussianBlur(texture, texture, cv::Size(0, 0), 3.0);
+        texture.convertTo(texture, -1, 2.0);
+        passed = check("smooth", texture) && passed;
+      }
+    }
+
+    if (vm.count("in"))
+    {
+      for (const fs::path& path : vm["in"].as<std::vector<fs::path>>())
+      {
+        cv::Mat texture = cv::imread(path.string(), cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH);
+        if (texture.empty())
+        {
+          std::cerr << "Could not read image: " << path << std::endl;
+          return -1;
+        }
+        if (texture.depth() == CV_8U)
+        {
+          texture.convertTo(texture, CV_16U, 257.0);
+        }
+        else if (texture.depth() != CV_16U)
+        {
+          texture.convertTo(texture, CV_16U, 65535.0);
+        }
+        passed = check(path.filename().string(), texture) && passed;
+      }
+    }
+
+    if (!passed)
+    {
+      std::cerr << "compute_intensity_sobel differs from the OpenCV reference." << std::endl;
+      return -1;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
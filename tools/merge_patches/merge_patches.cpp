@@ -39,6 +39,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "merge_patch.hpp"
 #include "patch.hpp"
 #include "texture.hpp"
+#include "thread_pool.hpp"
 
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
@@ -629,7 +630,8 @@ int main(int argc, char* argv[])
     ("target_id,t", po::value<int>(), "Target image ID")
     ("w_reg", po::value<double>(), "Dynamic programming regularization penalty")
     ("w_slope", po::value<double>(), "Dynamic programming slope penalty")
-    ("render_only", "Don't output cut patterns");
+    ("render_only", "Don't output cut patterns")
+    ("threads,j", po::value<int>(), "Number of threads for merging (0: all)");
 
   std::vector<fs::path> paths_in;
   fs::path path_out;
@@ -638,6 +640,7 @@ int main(int argc, char* argv[])
   double w_reg = 10.0;
   double w_slope = 1.0;
   bool render_only = false;
+  int num_threads = 0;
 
   /*
   std::vector<cv::Point2d> control_points_1({
@@ -786,6 +789,17 @@ int main(int argc, char* argv[])
     {
       render_only = true;
     }
+
+    if (vm.count("threads"))
+    {
+      num_threads = vm["threads"].as<int>();
+      if (num_threads < 0)
+      {
+        std::cerr << "Number of threads must not be negative." << std::endl
+          << desc << std::endl;
+        return -1;
+      }
+    }
   }
   catch (std::exception& e)
   {
@@ -794,6 +808,8 @@ int main(int argc, char* argv[])
     return -1;
   }
 
+  ThreadPool::Scope thread_pool(num_threads);
+
   try
   {
     /*
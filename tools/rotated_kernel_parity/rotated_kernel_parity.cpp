@@ -0,0 +1,197 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/math/constants/constants.hpp>
+#include <boost/program_options.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "feature_evaluator.hpp"
+#include "gabor_filter_bank.hpp"
+#include "rotated_kernel.hpp"
+#include "sqdiff_kernels.hpp"
+#include "texture.hpp"
+#include "validity_cache.hpp"
+
+namespace po = boost::program_options;
+
+/*
+ * Checks the costs of rotate_kernel against matching the kernel on the
+ * materialized rotation of the texture (FeatureEvaluator::rotate_response),
+ * on oriented textures with Gabor features. For rotations by multiples of the
+ * direction spacing both only differ by resampling, so the median relative
+ * cost difference over the compared positions has to stay small. Without the
+ * orientation shift of the kernel, the difference is printed for comparison.
+ */
+
+static const int num_directions = 4;
+static const double tolerance = 0.1;
+
+/*
+ * Stripes of the given orientation and period plus smooth noise, CV_16UC3.
+ */
+static cv::Mat stripes(cv::Size size, double orientation, double period, cv::RNG& rng)
+{
+  cv::Mat noise(size, CV_32FC1);
+  rng.fill(noise, cv::RNG::NORMAL, 0.0, 0.2);
+  cv::GaussianBlur(noise, noise, cv::Size(0, 0), 2.0);
+
+  cv::Mat intensity(size, CV_32FC1);
+  for (int y = 0; y < size.height; ++y)
+  {
+    float* ptr = intensity.ptr<float>(y);
+    for (int x = 0; x < size.width; ++x)
+    {
+      const double t = (x * std::cos(orientation) + y * std::sin(orientation)) / period;
+      ptr[x] = static_cast<float>(0.5 + 0.3 * std::sin(2.0 * boost::math::constants::pi<double>() * t)) + noise.at<float>(y, x);
+    }
+  }
+
+  cv::Mat texture;
+  intensity.convertTo(texture, CV_16UC1, 65535.0);
+  cv::cvtColor(texture, texture, cv::COLOR_GRAY2BGR);
+  return texture;
+}
+
+static double median(std::vector<double> values)
+{
+  if (values.empty())
+  {
+    return 0.0;
+  }
+  std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+  return values[values.size() / 2];
+}
+
+/*
+ * Median relative difference between the rotated kernel costs (scaled back to
+ * the unrotated mask) and the costs on the materialized rotation at the
+ * corresponding anchors. Only positions whose window lies well inside the
+ * rotated texture are compared.
+ */
+static double relative_difference(const FeatureVector& response, const FeatureVector& response_rotated, const cv::Mat& footprint, const Texture& rotated, const FeatureVector& kernel, const cv::Mat& kernel_mask, int num_frequencies, int* num_compared)
+{
+  const RotatedKernel rotated_kernel(kernel, kernel_mask, rotated.transformation_matrix, MatchingPrecision::UInt16, num_frequencies, num_directions);
+  const cv::Mat cost_kernel = sqdiff_masked_u16(response, rotated_kernel.response(), rotated_kernel.runs());
+  const cv::Mat cost_rotated = sqdiff_masked_u16(response_rotated, kernel, RowRunMask(kernel_mask));
+  const cv::Mat inside = valid_positions(footprint, kernel_mask, kernel.size());
+
+  std::vector<double> differences;
+  for (int y = 0; y < cost_kernel.rows; y += 5)
+  {
+    for (int x = 0; x < cost_kernel.cols; x += 5)
+    {
+      const cv::Point anchor = rotated_kernel.rotated_anchor(cv::Point(x, y), rotated.transformation_matrix, response_rotated.size());
+      if (inside.empty() || anchor.x >= inside.cols || anchor.y >= inside.rows || inside.at<unsigned char>(anchor) == 0)
+      {
+        continue;
+      }
+
+      const double cost = cost_kernel.at<float>(y, x) * rotated_kernel.cost_scale();
+      const double cost_reference = cost_rotated.at<float>(anchor);
+      differences.push_back(std::abs(cost - cost_reference) / std::max(cost_reference, 1e-12));
+    }
+  }
+
+  *num_compared = static_cast<int>(differences.size());
+  return median(differences);
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    po::options_description desc("Allowed options");
+    desc.add_options()
+      ("help,h", "Show this help message")
+      ("seed,s", po::value<unsigned int>()->default_value(1), "Seed of the random textures");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc, po::command_line_style::unix_style), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+      std::cout << desc << std::endl;
+      return 0;
+    }
+
+    const double pi = boost::math::constants::pi<double>();
+    const GaborFilterBank filter_bank(32, 1.0, num_directions);
+    const FeatureEvaluator evaluator(0.5, 0.5, 1.0, filter_bank);
+
+    cv::RNG rng(vm["seed"].as<unsigned int>());
+    Texture texture;
+    texture.texture = stripes(cv::Size(240, 200), pi / 6.0, 10.0, rng);
+    texture.mask_done = cv::Mat(texture.texture.size(), CV_8UC1, cv::Scalar(255));
+    texture.mask_rotation = cv::Mat(texture.texture.size(), CV_8UC1, cv::Scalar(255));
+    const FeatureVector response = evaluator.evaluate(texture.texture);
+
+    // Kernel features from the interior of an unrelated texture with a different orientation.
+    const FeatureVector kernel_response = evaluator.evaluate(stripes(cv::Size(96, 96), 0.0, 12.0, rng));
+    const FeatureVector kernel = kernel_response(cv::Rect(36, 36, 24, 24));
+    const cv::Mat kernel_mask(kernel.size(), CV_8UC1, cv::Scalar(255));
+
+    bool passed = true;
+    for (int k = 1; k < 2 * num_directions; ++k)
+    {
+      const Texture rotated = texture.rotate(-k * pi / num_directions);
+      const FeatureVector response_rotated = evaluator.rotate_response(response, rotated.transformation_matrix, rotated.texture.size());
+
+      // Away from the zero border of the rotated features.
+      cv::Mat footprint;
+      cv::erode(rotated.mask_rotation, footprint, cv::Mat::ones(9, 9, CV_8UC1));
+
+      int num_compared = 0;
+      const double difference = relative_difference(response, response_rotated, footprint, rotated, kernel, kernel_mask, filter_bank.num_frequencies(), &num_compared);
+      const double difference_unshifted = relative_difference(response, response_rotated, footprint, rotated, kernel, kernel_mask, 0, &num_compared);
+
+      const bool ok = num_compared > 0 && difference <= tolerance;
+      passed = passed && ok;
+
+      std::cout << (ok ? "ok     " : "FAILED ") << "rotation " << k << " * pi / " << num_directions << ": " << num_compared << " positions, median relative difference "
+        << difference << " (" << difference_unshifted << " without orientation shift)" << std::endl;
+    }
+
+    if (!passed)
+    {
+      std::cerr << "rotate_kernel costs differ from the costs on the rotated texture." << std::endl;
+      return -1;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,262 @@
+/*
+WoodPixel - Supplementary code for Computational Parquetry:
+            Fabricated Style Transfer with Wood Pixels
+            ACM Transactions on Graphics 39(2), 2020
+
+Copyright (C) 2020  Julian Iseringhausen, University of Bonn, <iseringhausen@cs.uni-bonn.de>
+Copyright (C) 2020  Matthias Hullin, University of Bonn, <hullin@cs.uni-bonn.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "bit_mask.hpp"
+#include "feature_spectrum.hpp"
+#include "feature_vector.hpp"
+#include "sqdiff_kernels.hpp"
+
+namespace po = boost::program_options;
+
+/*
+ * Checks the matching kernels against OpenCV on random feature stacks and
+ * random non-rectangular masks: sqdiff_masked and sqdiff_masked_u16 against
+ * the masked cv::matchTemplate cost map summed over all channels, sqdiff_fft
+ * against the unmasked one, and the BitMask erosions against cv::erode with
+ * the kernel anchored at its top left corner and a constant 0 border. Costs
+ * may differ by float rounding relative to the largest reference cost,
+ * erosions have to be exact.
+ */
+
+static const double tolerance = 1e-4;
+
+/*
+ * Uniform noise, so that costs and feature energies are of the same magnitude
+ * and rounding errors of the reference stay well below the tolerance.
+ */
+static FeatureVector random_features(cv::RNG& rng, cv::Size size, int num_channels)
+{
+  std::vector<cv::Mat> channels(num_channels);
+  for (cv::Mat& channel : channels)
+  {
+    channel.create(size, CV_16UC1);
+    rng.fill(channel, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(65536));
+  }
+  return FeatureVector(channels);
+}
+
+/*
+ * Blobs of thresholded smooth noise (lower thresholds set more pixels) around
+ * a set center pixel, CV_8UC1 with values 0 and 255.
+ */
+static cv::Mat random_mask(cv::RNG& rng, cv::Size size, double threshold)
+{
+  cv::Mat noise(size, CV_32FC1);
+  rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0.0), cv::Scalar::all(1.0));
+  cv::GaussianBlur(noise, noise, cv::Size(0, 0), 2.0);
+  cv::normalize(noise, noise, 0.0, 1.0, cv::NORM_MINMAX);
+
+  cv::Mat mask = noise > threshold;
+  mask.at<unsigned char>(size.height / 2, size.width / 2) = 255;
+  return mask;
+}
+
+/*
+ * Multi-channel SQDIFF as in Texture::template_match, masked unless mask is empty.
+ */
+static cv::Mat reference_sqdiff(const FeatureVector& texture, const FeatureVector& kernel, const cv::Mat& mask)
+{
+  cv::Mat mask_float;
+  if (!mask.empty())
+  {
+    mask_float = cv::Mat::zeros(mask.size(), CV_32FC1);
+    mask_float.setTo(1.0f, mask != 0);
+  }
+
+  cv::Mat match;
+  cv::Mat match_sum = cv::Mat::zeros(texture.rows() - kernel.rows() + 1, texture.cols() - kernel.cols() + 1, CV_32FC1);
+  for (int i = 0; i < texture.num_channels(); ++i)
+  {
+    cv::matchTemplate(texture.channel_float(i), kernel.channel_float(i), match, cv::TM_SQDIFF, mask_float);
+    match_sum += match;
+  }
+  return match_sum;
+}
+
+/*
+ * Largest cost difference at the valid positions relative to the largest
+ * reference cost, infinite if an invalid position is not set to FLT_MAX.
+ */
+static double cost_difference(const cv::Mat& costs, const cv::Mat& reference, const cv::Mat& valid = cv::Mat())
+{
+  if (costs.size() != reference.size() || costs.type() != CV_32FC1)
+  {
+    return HUGE_VAL;
+  }
+
+  double max_reference;
+  cv::minMaxLoc(reference, nullptr, &max_reference);
+
+  double max_diff = 0.0;
+  for (int y = 0; y < costs.rows; ++y)
+  {
+    for (int x = 0; x < costs.cols; ++x)
+    {
+      if (!valid.empty() && valid.at<unsigned char>(y, x) == 0)
+      {
+        if (costs.at<float>(y, x) != FLT_MAX)
+        {
+          return HUGE_VAL;
+        }
+        continue;
+      }
+      max_diff = std::max(max_diff, std::abs(static_cast<double>(costs.at<float>(y, x)) - reference.at<float>(y, x)));
+    }
+  }
+  return max_diff / std::max(max_reference, 1.0);
+}
+
+static bool report_cost(const char* name, double diff, cv::Size texture_size, cv::Size kernel_size, int num_channels)
+{
+  const bool ok = diff <= tolerance;
+  std::cout << (ok ? "ok     " : "FAILED ") << name << " " << texture_size.width << "x" << texture_size.height << "x" << num_channels
+    << ", kernel " << kernel_size.width << "x" << kernel_size.height << ": relative difference " << diff << std::endl;
+  return ok;
+}
+
+static bool check_costs(cv::RNG& rng, cv::Size texture_size, cv::Size kernel_size, int num_channels)
+{
+  const FeatureVector texture = random_features(rng, texture_size, num_channels);
+  const FeatureVector kernel = random_features(rng, kernel_size, num_channels);
+  const cv::Mat kernel_mask = random_mask(rng, kernel_size, 0.5);
+  const RowRunMask kernel_runs(kernel_mask);
+
+  // About three quarters of the positions valid.
+  cv::Mat valid(texture_size.height - kernel_size.height + 1, texture_size.width - kernel_size.width + 1, CV_8UC1);
+  rng.fill(valid, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(4));
+  valid = valid != 0;
+
+  const cv::Mat reference_masked = reference_sqdiff(texture, kernel, kernel_mask);
+  const cv::Mat reference = reference_sqdiff(texture, kernel, cv::Mat());
+
+  const cv::Size dft_size = FeatureSpectrum::optimal_dft_size(texture_size);
+  const cv::Mat costs_fft = sqdiff_fft(FeatureSpectrum(texture, dft_size), FeatureSpectrum(kernel, dft_size));
+
+  bool passed = true;
+  passed = report_cost("sqdiff_masked", cost_difference(sqdiff_masked(texture, kernel, kernel_runs), reference_masked), texture_size, kernel_size, num_channels) && passed;
+  passed = report_cost("sqdiff_masked valid", cost_difference(sqdiff_masked(texture, kernel, kernel_runs, valid), reference_masked, valid), texture_size, kernel_size, num_channels) && passed;
+  passed = report_cost("sqdiff_masked_u16", cost_difference(sqdiff_masked_u16(texture, kernel, kernel_runs), reference_masked), texture_size, kernel_size, num_channels) && passed;
+  passed = report_cost("sqdiff_masked_u16 valid", cost_difference(sqdiff_masked_u16(texture, kernel, kernel_runs, valid), reference_masked, valid), texture_size, kernel_size, num_channels) && passed;
+  passed = report_cost("sqdiff_fft", cost_difference(costs_fft, reference), texture_size, kernel_size, num_channels) && passed;
+  return passed;
+}
+
+static bool check_erosion(cv::RNG& rng, cv::Size mask_size, cv::Size kernel_size)
+{
+  const cv::Mat mask = random_mask(rng, mask_size, 0.3);
+  const cv::Mat kernel_mask = random_mask(rng, kernel_size, 0.5);
+  const BitMask mask_bits(mask);
+
+  cv::Mat reference, reference_rect;
+  cv::erode(mask, reference, kernel_mask, cv::Point(0, 0), 1, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+  cv::erode(mask, reference_rect, cv::Mat::ones(kernel_size, CV_8UC1), cv::Point(0, 0), 1, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+
+  const int diff = cv::countNonZero(mask_bits.erode(RowRunMask(kernel_mask)).to_mat() != reference);
+  const int diff_rect = cv::countNonZero(mask_bits.erode(kernel_size.width, kernel_size.height).to_mat() != reference_rect);
+  const bool ok = diff == 0 && diff_rect == 0;
+
+  std::cout << (ok ? "ok     " : "FAILED ") << "erode " << mask_size.width << "x" << mask_size.height << ", kernel " << kernel_size.width << "x" << kernel_size.height
+    << ": differing pixels " << diff << ", rectangle " << diff_rect << std::endl;
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    po::options_description desc("Allowed options");
+    desc.add_options()
+      ("help,h", "Show this help message")
+      ("seed,s", po::value<unsigned int>()->default_value(1), "Seed of the random features and masks");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc, po::command_line_style::unix_style), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+      std::cout << desc << std::endl;
+      return 0;
+    }
+
+    bool passed = true;
+    cv::RNG rng(vm["seed"].as<unsigned int>());
+
+    // Odd run lengths cover the scalar tails after the vector loops.
+    const struct
+    {
+      cv::Size texture_size;
+      cv::Size kernel_size;
+      int num_channels;
+    } cost_cases[] = {
+      {cv::Size(64, 64), cv::Size(16, 16), 1},
+      {cv::Size(97, 83), cv::Size(1, 1), 3},
+      {cv::Size(130, 65), cv::Size(33, 17), 3},
+      {cv::Size(200, 150), cv::Size(65, 9), 4},
+      {cv::Size(257, 129), cv::Size(70, 40), 7}
+    };
+    for (const auto& c : cost_cases)
+    {
+      passed = check_costs(rng, c.texture_size, c.kernel_size, c.num_channels) && passed;
+    }
+
+    // Sizes around the 64 pixel words of BitMask.
+    const cv::Size mask_sizes[] = {cv::Size(64, 64), cv::Size(65, 33), cv::Size(129, 70), cv::Size(300, 200)};
+    const cv::Size kernel_sizes[] = {cv::Size(1, 1), cv::Size(5, 3), cv::Size(17, 31), cv::Size(64, 9), cv::Size(65, 20), cv::Size(130, 7)};
+    for (const cv::Size& mask_size : mask_sizes)
+    {
+      for (const cv::Size& kernel_size : kernel_sizes)
+      {
+        if (kernel_size.width <= mask_size.width && kernel_size.height <= mask_size.height)
+        {
+          passed = check_erosion(rng, mask_size, kernel_size) && passed;
+        }
+      }
+    }
+
+    if (!passed)
+    {
+      std::cerr << "Matching kernels differ from the OpenCV reference." << std::endl;
+      return -1;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}